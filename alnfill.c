@@ -34,6 +34,15 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 
 #include "ketopt.h"
@@ -45,6 +54,8 @@
 #include "sdict.h"
 #include "misc.h"
 #include "paf.h"
+#include "sock.h"
+#include "gapbin.h"
 
 #define ALNFILL_VERSION "0.1"
 
@@ -58,10 +69,32 @@ typedef struct {
     int64  tbeg, tend;
     int    qbol, qeol;
     int    tbol, teol;
+    int64  gidx; // index in the interval file
 } interval_t;
 
+typedef kvec_t(interval_t) interval_v;
+
+typedef struct {
+    int    tid; // thread temporary file
+    int64  off, len;
+} oblock_t;
+
+typedef struct {
+    int64  beg; // first interval in the order
+    int    n;
+} task_t;
+
 typedef struct {
+    int n_threads;
     interval_t *intervals;
+    oblock_t *oblocks;
+    int64 *order;
+    task_t *tasks;
+    int64 n_tasks, n_done;
+    int64 *w_next; // next task of each event loop thread
+    int n_slots; // number of concurrent lastz runs
+    int locality; // sorted tasks in contiguous per-thread runs
+    int tag_gidx;
     FILE **tmpfds;
     char **cmds;
     char **tfiles;
@@ -94,124 +127,369 @@ void check_executable(char *exe)
 
 static pthread_mutex_t print_mutex;
 
-static inline int paf_parse1(int l, char *s, int64 qlen, int64 qbeg, int64 tlen, int64 tbeg, FILE *out)
+static inline int paf_parse1(int l, char *s, const char *qname, int64 qlen, int64 qbeg, const char *tname, int64 tlen, int64 tbeg, int64 gidx, FILE *out)
 { 
-    char *q;
-	int i, t;
-    while (isspace(*s)) s++;
-    if (*s == '\0') return -1;
-	for (i = t = 0, q = s; i <= l; ++i) {
-		if (i < l && s[i] != '\t') continue;
-		s[i] = 0;
-        switch (t) {
-            case 0:
-            case 4:
-            case 5:
-                fprintf(out, "%s\t", q);
-                break;
-            case 1:
-                fprintf(out, "%lld\t", qlen);
-                break;
-            case 2:
-            case 3:
-                fprintf(out, "%lld\t", strtol(q, NULL, 10) + qbeg);
-                break;
-            case 6:
-                fprintf(out, "%lld\t", tlen);
-                break;
-            case 7:
-            case 8:
-                fprintf(out, "%lld\t", strtol(q, NULL, 10) + tbeg);
-                break;
-            case 9:
-                s[i] = '\t';
-                fprintf(out, "%s\n", q);
-                return 0;
-        }
-		++t, q = i < l? &s[i+1] : 0;
-	}
-	return 0;
+    // rewrite the first nine columns to interval coordinates; the rest of the line is copied as is
+    int tabs[9];
+    while (l > 0 && isspace(*s)) s++, l--;
+    if (l == 0 || paf_tabs(s, l, tabs, 9) < 9) return -1;
+    if (qname) fputs(qname, out);
+    else fwrite(s, 1, tabs[0], out);
+    fprintf(out, "\t%lld\t%lld\t%lld\t%.*s\t", qlen, paf_atou(s + tabs[1] + 1) + qbeg, paf_atou(s + tabs[2] + 1) + qbeg,
+        tabs[4] - tabs[3] - 1, s + tabs[3] + 1);
+    if (tname) fputs(tname, out);
+    else fwrite(s + tabs[4] + 1, 1, tabs[5] - tabs[4] - 1, out);
+    fprintf(out, "\t%lld\t%lld\t%lld\t%.*s", tlen, paf_atou(s + tabs[6] + 1) + tbeg, paf_atou(s + tabs[7] + 1) + tbeg,
+        l - tabs[8] - 1, s + tabs[8] + 1);
+    if (gidx >= 0)
+        fprintf(out, "\tgi:i:%lld", gidx);
+    fputc('\n', out);
+    return 0;
 }
 
-static inline int paf_read1(paf_file_t *pf, int64 qlen, int64 qbeg, int64 tlen, int64 tbeg, FILE *out)
+static inline int paf_read1(paf_file_t *pf, int64 qlen, int64 qbeg, int64 tlen, int64 tbeg, int64 gidx, FILE *out)
 {
-	int ret, dret;
+	int ret;
 file_read_more:
-	ret = ks_getuntil((kstream_t*)pf->fp, KS_SEP_LINE, &pf->buf, &dret);
-	if (ret < 0) return ret;
-	ret = paf_parse1(pf->buf.l, pf->buf.s, qlen, qbeg, tlen, tbeg, out);
+	if (paf_read_line(pf) == NULL) return -1;
+	ret = paf_parse1(pf->buf.l, pf->buf.s, 0, qlen, qbeg, 0, tlen, tbeg, gidx, out);
 	if (ret < 0) goto file_read_more;
 	return ret;
 }
 
-void lastz_fill(void *_data, long i, int tid)
+static inline int paf_batch_index(const char *s, char c, int col)
 {
-    data_t *data = (data_t *) _data;
-    interval_t *interval = &data->intervals[i];
-    uint32 tsid, qsid;
-    int64 tlen, tbeg, qlen, qbeg;
-    FILE *tfile, *qfile, *tmpfd;
-    paf_file_t *pfile;
+    // batch member index from a record name "[qt]INT" in column col
+    int t;
+    for (t = 0; t < col && *s; s++)
+        if (*s == '\t') t++;
+    if (*s != c) return -1;
+    return strtol(s + 1, NULL, 10);
+}
 
-    tbeg = interval->tbeg;
-    qbeg = interval->qbeg;
-    tsid = interval->tsid;
-    qsid = interval->qsid;
-    tlen = data->tdicts->s[tsid].len;
-    qlen = data->qdicts->s[qsid].len;
+static void write_slice(FILE *fp, const char *name, int k, const char *seq, int64 beg, int64 end)
+{
+    if (name) fprintf(fp, ">%s\n", name);
+    else fprintf(fp, ">%c%d\n", k < 0? 't' : 'q', k < 0? -k - 1 : k);
+    fwrite(seq + beg, sizeof(char), end - beg, fp);
+    fputc('\n', fp);
+}
 
-    tfile = fopen(data->tfiles[tid], "w");
-    qfile = fopen(data->qfiles[tid], "w");
+static void run_lastz(char *cmd, int tid)
+{
+    if (run_system_cmd(cmd, 1)) {
+        fprintf(stderr, "[E::%s] [thread %d] failed to execute system command: %s\n", __func__, tid, cmd);
+        exit (1);
+    }
+}
+
+static void task_span(data_t *data, task_t *task, int64 *beg, int64 *end)
+{
+    // target range spanned by the intervals of a task; they all share one target sequence
+    interval_t *interval;
+    int k;
+    *beg = INT64_MAX, *end = 0;
+    for (k = 0; k < task->n; k++) {
+        interval = &data->intervals[data->order[task->beg + k]];
+        *beg = MIN(*beg, interval->tbeg);
+        *end = MAX(*end, interval->tend);
+    }
+}
+
+static void stage_task(data_t *data, task_t *task, int slot, int tid)
+{
+    // write the sequence slices of a task to the files of a slot
+    // a group of small intervals is written as one target slice spanning the group, and one query
+    // record per interval named by its position; hits outside each record's own slice are dropped
+    interval_t *interval;
+    FILE *tfile, *qfile;
+    int64 tbeg, tend;
+    int k;
+
+    tfile = fopen(data->tfiles[slot], "w");
+    qfile = fopen(data->qfiles[slot], "w");
     if (tfile == NULL || qfile == NULL) {
         fprintf(stderr, "[E::%s] [thread %d] failed to open files to write\n", __func__, tid);
         exit (1);
     }
-    
-    fprintf(tfile, ">%s\n", data->tdicts->s[tsid].name);
-    fwrite(data->tdicts->s[tsid].seq + interval->tbeg, sizeof(char), interval->tend - interval->tbeg, tfile);
-    fputc('\n', tfile);
-    fprintf(qfile, ">%s\n", data->qdicts->s[qsid].name);
-    fwrite(data->qdicts->s[qsid].seq + interval->qbeg, sizeof(char), interval->qend - interval->qbeg, qfile);
-    fputc('\n', qfile);
-
+    if (task->n == 1) {
+        interval = &data->intervals[data->order[task->beg]];
+        write_slice(tfile, data->tdicts->s[interval->tsid].name, 0, data->tdicts->s[interval->tsid].seq, interval->tbeg, interval->tend);
+        write_slice(qfile, data->qdicts->s[interval->qsid].name, 0, data->qdicts->s[interval->qsid].seq, interval->qbeg, interval->qend);
+    } else {
+        task_span(data, task, &tbeg, &tend);
+        interval = &data->intervals[data->order[task->beg]];
+        write_slice(tfile, 0, -1, data->tdicts->s[interval->tsid].seq, tbeg, tend);
+        for (k = 0; k < task->n; k++) {
+            interval = &data->intervals[data->order[task->beg + k]];
+            write_slice(qfile, 0, k, data->qdicts->s[interval->qsid].seq, interval->qbeg, interval->qend);
+        }
+    }
     if (fclose(tfile) || fclose(qfile)) {
         fprintf(stderr, "[E::%s] [thread %d] failed to close files\n", __func__, tid);
         exit (1);
     }
-    
-    if (run_system_cmd(data->cmds[tid], 1)) {
-        fprintf(stderr, "[E::%s] [thread %d] failed to execute system command: %s\n", __func__, tid, data->cmds[tid]);
-        exit (1);
-    } else {
-        pfile = paf_open(data->pfiles[tid]);
-        if (!pfile) {
-            fprintf(stderr, "[E::%s] [thread %d] cannot open paf file to read: %s\n", __func__, tid, data->pfiles[tid]);
-            exit (1);
-        }
-        
-        tmpfd = data->tmpfds[tid];
-        while (paf_read1(pfile, qlen, qbeg, tlen, tbeg, tmpfd) >= 0);
+}
 
-        if (paf_close(pfile)) {
-            fprintf(stderr, "[E::%s] [thread %d] failed to close file: %s\n", __func__, tid, data->pfiles[tid]);
-            exit (1);
-        }
+static void drain_single(data_t *data, paf_file_t *pfile, int64 i, int tid)
+{
+    interval_t *interval = &data->intervals[i];
+    FILE *tmpfd = data->tmpfds[tid];
+    data->oblocks[i].tid = tid;
+    data->oblocks[i].off = ftell(tmpfd);
+    while (paf_read1(pfile, data->qdicts->s[interval->qsid].len, interval->qbeg, 
+                data->tdicts->s[interval->tsid].len, interval->tbeg, data->tag_gidx? interval->gidx : -1, tmpfd) >= 0);
+    data->oblocks[i].len = ftell(tmpfd) - data->oblocks[i].off;
+}
+
+static void drain_multi(data_t *data, task_t *task, paf_file_t *pfile, int tid)
+{
+    // records are demultiplexed by query name, and only kept if they lie within the target
+    // slice of their own interval; target positions are relative to the span of the task
+    int64 *idx = data->order + task->beg, tbeg, tend, ts, te;
+    interval_t *interval;
+    sd_seq_t *tsq, *qsq;
+    FILE *tmpfd, **outs;
+    char **bufs, *line;
+    size_t *lens;
+    int n = task->n, k, tabs[9];
+
+    MYCALLOC(outs, n);
+    MYCALLOC(bufs, n);
+    MYCALLOC(lens, n);
+    if (outs == NULL || bufs == NULL || lens == NULL)
+        mem_alloc_error("batch outputs");
+    for (k = 0; k < n; k++) {
+        outs[k] = open_memstream(&bufs[k], &lens[k]);
+        if (outs[k] == NULL)
+            mem_alloc_error("batch outputs");
+    }
+    task_span(data, task, &tbeg, &tend);
+    while ((line = paf_read_line(pfile)) != NULL) {
+        k = paf_batch_index(line, 'q', 0);
+        if (k < 0 || k >= n || paf_tabs(line, pfile->buf.l, tabs, 9) < 9) continue;
+        interval = &data->intervals[idx[k]];
+        ts = tbeg + paf_atou(line + tabs[6] + 1);
+        te = tbeg + paf_atou(line + tabs[7] + 1);
+        if (ts < interval->tbeg || te > interval->tend) continue;
+        tsq = &data->tdicts->s[interval->tsid];
+        qsq = &data->qdicts->s[interval->qsid];
+        paf_parse1(pfile->buf.l, line, qsq->name, qsq->len, interval->qbeg, tsq->name, tsq->len, tbeg,
+                data->tag_gidx? interval->gidx : -1, outs[k]);
     }
 
-    if (unlink(data->tfiles[tid]) == -1 || 
-        unlink(data->qfiles[tid]) == -1 ||
-        unlink(data->pfiles[tid]) == -1 ) {
+    tmpfd = data->tmpfds[tid];
+    for (k = 0; k < n; k++) {
+        fclose(outs[k]);
+        data->oblocks[idx[k]].tid = tid;
+        data->oblocks[idx[k]].off = ftell(tmpfd);
+        data->oblocks[idx[k]].len = lens[k];
+        fwrite(bufs[k], 1, lens[k], tmpfd);
+        free(bufs[k]);
+    }
+    free(outs);
+    free(bufs);
+    free(lens);
+}
+
+static void drain_task(data_t *data, task_t *task, int slot, int tid)
+{
+    // move the lastz output of a slot to the thread temporary file
+    paf_file_t *pfile;
+    int64 n0, n1;
+
+    pfile = paf_open(data->pfiles[slot]);
+    if (!pfile) {
+        fprintf(stderr, "[E::%s] [thread %d] cannot open paf file to read: %s\n", __func__, tid, data->pfiles[slot]);
+        exit (1);
+    }
+    if (task->n == 1)
+        drain_single(data, pfile, data->order[task->beg], tid);
+    else
+        drain_multi(data, task, pfile, tid);
+    if (paf_close(pfile)) {
+        fprintf(stderr, "[E::%s] [thread %d] failed to close file: %s\n", __func__, tid, data->pfiles[slot]);
+        exit (1);
+    }
+
+    if (unlink(data->tfiles[slot]) == -1 ||
+        unlink(data->qfiles[slot]) == -1 ||
+        unlink(data->pfiles[slot]) == -1 ) {
         fprintf(stderr, "[E::%s] [thread %d] failed to remove files\n", __func__, tid);
         exit (1);
     }
 
-    if (i % 10000 == 0) {
+    n1 = __sync_add_and_fetch(&data->n_done, task->n);
+    n0 = n1 - task->n;
+    if (n0 / 10000 != n1 / 10000 || n0 == 0) {
         pthread_mutex_lock(&print_mutex);
-        fprintf(stderr, "[M::%s] [thread %d] processed %ld intervals\n", __func__, tid, i);
+        fprintf(stderr, "[M::%s] [thread %d] processed %lld intervals\n", __func__, tid, n1);
         pthread_mutex_unlock(&print_mutex);
     }
 }
 
+void lastz_fill(void *_data, long j, int tid)
+{
+    data_t *data = (data_t *) _data;
+    task_t *task = &data->tasks[j];
+    stage_task(data, task, tid, tid);
+    run_lastz(data->cmds[tid], tid);
+    drain_task(data, task, tid, tid);
+}
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+extern char **environ;
+
+static pid_t spawn_cmd(char *cmd)
+{
+    pid_t pid;
+    char *argv[] = {"sh", "-c", cmd, NULL};
+    if (posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, environ))
+        return -1;
+    return pid;
+}
+
+typedef struct {
+    data_t *data;
+    int tid;
+    int s_beg, s_end; // slots owned by this thread
+} loop_t;
+
+static int64 claim_task(data_t *data, int tid)
+{
+    // same order as kt_for(): thread t takes tasks t, t+T, ... then steals from the least advanced thread
+    int i, min_i;
+    int64 j, min;
+    j = __sync_fetch_and_add(&data->w_next[tid], data->n_threads);
+    if (j < data->n_tasks) return j;
+    min = INT64_MAX, min_i = -1;
+    for (i = 0; i < data->n_threads; i++)
+        if (min > data->w_next[i]) min = data->w_next[i], min_i = i;
+    if (min_i < 0 || min >= data->n_tasks) return -1;
+    j = __sync_fetch_and_add(&data->w_next[min_i], data->n_threads);
+    return j < data->n_tasks? j : -1;
+}
+
+static void *fill_loop(void *_loop)
+{
+    // each thread keeps up to (s_end - s_beg) lastz children running
+    // inputs of the next task are staged and outputs drained while the others run
+    loop_t *loop = (loop_t *) _loop;
+    data_t *data = loop->data;
+    int tid = loop->tid;
+    int i, n, slot, status, efd, n_run;
+    int64 j;
+    struct epoll_event ev, evs[64];
+    pid_t *pids;
+    int *pfds;
+    int64 *jobs;
+
+    MYCALLOC(pids, data->n_slots);
+    MYCALLOC(pfds, data->n_slots);
+    MYCALLOC(jobs, data->n_slots);
+    efd = epoll_create1(EPOLL_CLOEXEC);
+    if (pids == NULL || pfds == NULL || jobs == NULL || efd == -1) {
+        fprintf(stderr, "[E::%s] [thread %d] failed to set up event loop\n", __func__, tid);
+        exit (1);
+    }
+
+    n_run = 0;
+    for (;;) {
+        // fill free slots
+        for (slot = loop->s_beg; slot < loop->s_end; slot++) {
+            if (pids[slot] > 0) continue;
+            j = claim_task(data, tid);
+            if (j < 0) break;
+            stage_task(data, &data->tasks[j], slot, tid);
+            pids[slot] = spawn_cmd(data->cmds[slot]);
+            if (pids[slot] < 0) {
+                fprintf(stderr, "[E::%s] [thread %d] failed to execute system command: %s\n", __func__, tid, data->cmds[slot]);
+                exit (1);
+            }
+            pfds[slot] = syscall(SYS_pidfd_open, pids[slot], 0);
+            ev.events = EPOLLIN;
+            ev.data.u32 = slot;
+            if (pfds[slot] == -1 || epoll_ctl(efd, EPOLL_CTL_ADD, pfds[slot], &ev) == -1) {
+                fprintf(stderr, "[E::%s] [thread %d] failed to watch child process: %s\n", __func__, tid, strerror(errno));
+                exit (1);
+            }
+            jobs[slot] = j;
+            ++n_run;
+        }
+        if (n_run == 0) break;
+
+        // wait for children and drain their outputs
+        n = epoll_wait(efd, evs, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[E::%s] [thread %d] epoll_wait failed: %s\n", __func__, tid, strerror(errno));
+            exit (1);
+        }
+        for (i = 0; i < n; i++) {
+            slot = evs[i].data.u32;
+            if (waitpid(pids[slot], &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+                fprintf(stderr, "[E::%s] [thread %d] failed to execute system command: %s\n", __func__, tid, data->cmds[slot]);
+                exit (1);
+            }
+            epoll_ctl(efd, EPOLL_CTL_DEL, pfds[slot], NULL);
+            close(pfds[slot]);
+            pids[slot] = 0;
+            --n_run;
+            drain_task(data, &data->tasks[jobs[slot]], slot, tid);
+        }
+    }
+
+    close(efd);
+    free(pids);
+    free(pfds);
+    free(jobs);
+    return 0;
+}
+
+static int pidfd_supported(void)
+{
+    int fd = syscall(SYS_pidfd_open, getpid(), 0);
+    if (fd == -1) return 0;
+    close(fd);
+    return 1;
+}
+#endif
+
+static void fill_run(data_t *data)
+{
+    // with more jobs than threads, children are managed with pidfd/epoll event loops
+    // otherwise each thread runs one lastz at a time
+#ifdef __linux__
+    if (data->n_slots > data->n_threads && pidfd_supported()) {
+        int t, n = data->n_threads;
+        pthread_t tids[n];
+        loop_t loops[n];
+        int64 w_next[n];
+        for (t = 0; t < n; t++) w_next[t] = t;
+        data->w_next = w_next;
+        if (VERBOSE > 0)
+            fprintf(stderr, "[M::%s] running up to %d lastz jobs with %d threads\n", __func__, data->n_slots, n);
+        for (t = 0; t < n; t++) {
+            loops[t].data = data;
+            loops[t].tid = t;
+            loops[t].s_beg = (int64) data->n_slots * t / n;
+            loops[t].s_end = (int64) data->n_slots * (t + 1) / n;
+            pthread_create(&tids[t], 0, fill_loop, &loops[t]);
+        }
+        for (t = 0; t < n; t++)
+            pthread_join(tids[t], 0);
+        return;
+    }
+#endif
+    kt_for(data->n_threads, lastz_fill, data, data->n_tasks);
+}
+
 static inline int parse_interval(int l, char *s, char **qname, int64 *qbeg, int64 *qend, char **tname, int64 *tbeg, int64 *tend, 
     int *qbol, int *qeol, int *tbol, int *teol)
 {
@@ -296,34 +574,1071 @@ static inline int parse_interval(int l, char *s, char **qname, int64 *qbeg, int6
 	return fields;
 }
 
+static int read_intervals_bin(const char *fn, sdict_t *qdicts, sdict_t *tdicts, interval_v *intervals)
+{
+    // a binary interval file from "alngap --binary" is mapped; names are put once and records copied
+    // sequence lengths are kept to be checked against the loaded sequences
+    int fd, k;
+    struct stat st;
+    char magic[8];
+    const char *map, *p, *end;
+    const gapbin_hdr_t *h;
+    const gapbin_rec_t *r;
+    uint32 *ids[2], len, i;
+    uint64 sum;
+    int64 j, n;
+    sdict_t *d;
+
+    if ((fd = open(fn, O_RDONLY)) < 0)
+        return 0;
+    if (pread(fd, magic, 8, 0) != 8 || memcmp(magic, GAPBIN_MAGIC, 8) != 0) {
+        close(fd);
+        return 0;
+    }
+    map = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(gapbin_hdr_t)) {
+        map = (const char *) mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+    }
+    close(fd);
+    if (map == NULL) {
+        fprintf(stderr, "[E::%s] failed to map binary interval file %s\n", __func__, fn);
+        exit (1);
+    }
+    madvise((void *) map, st.st_size, MADV_SEQUENTIAL);
+    h = (const gapbin_hdr_t *) map;
+    if ((uint64) st.st_size < sizeof(gapbin_hdr_t) + h->l_names || (st.st_size - sizeof(gapbin_hdr_t) - h->l_names) % sizeof(gapbin_rec_t)) {
+        fprintf(stderr, "[E::%s] truncated binary interval file %s\n", __func__, fn);
+        exit (1);
+    }
+
+    p = map + sizeof(gapbin_hdr_t);
+    end = p + h->l_names;
+    for (k = 0; k < 2; k++) {
+        d = k == 0? qdicts : tdicts;
+        MYMALLOC(ids[k], MAX(h->n_seq[k], 1));
+        if (ids[k] == NULL)
+            mem_alloc_error("interval names");
+        sum = GAPBIN_SUM0;
+        for (i = 0; i < h->n_seq[k]; i++) {
+            if (p + sizeof(uint32) >= end || memchr(p + sizeof(uint32), 0, end - p - sizeof(uint32)) == NULL)
+                break;
+            memcpy(&len, p, sizeof(uint32));
+            p += sizeof(uint32);
+            ids[k][i] = sd_put(d, p, len);
+            sum = gapbin_sum(sum, p, len);
+            p += strlen(p) + 1;
+        }
+        if (i < h->n_seq[k] || sum != h->sum[k]) {
+            fprintf(stderr, "[E::%s] corrupted name table in binary interval file %s\n", __func__, fn);
+            exit (1);
+        }
+    }
+
+    r = (const gapbin_rec_t *) end;
+    n = (st.st_size - sizeof(gapbin_hdr_t) - h->l_names) / sizeof(gapbin_rec_t);
+    kv_resize(interval_t, *intervals, intervals->n + n);
+    for (j = 0; j < n; j++, r++) {
+        if (r->qid >= h->n_seq[0] || r->tid >= h->n_seq[1]) {
+            fprintf(stderr, "[E::%s] sequence index out of range in binary interval file %s\n", __func__, fn);
+            exit (1);
+        }
+        intervals->a[intervals->n++] = (interval_t){ids[0][r->qid], ids[1][r->tid],
+            r->qbeg, r->qend, r->tbeg, r->tend, r->qbol, r->qeol, r->tbol, r->teol, j};
+    }
+    munmap((void *) map, st.st_size);
+    free(ids[0]);
+    free(ids[1]);
+    return 1;
+}
+
+static void read_intervals(const char *fn, sdict_t *qdicts, sdict_t *tdicts, interval_v *intervals)
+{
+    // read through the PAF line reader, which maps uncompressed files
+    paf_file_t *fp;
+    char *line;
+    char *qname, *tname;
+    int64 qbeg, qend, tbeg, tend, gidx;
+    int qbol, qeol, tbol, teol;
+    int fields;
+
+    if (read_intervals_bin(fn, qdicts, tdicts, intervals))
+        return;
+    fp = paf_open(fn);
+    if (!fp) {
+        fprintf(stderr, "[E::%s] failed to open file %s to read\n", __func__, fn);
+        exit (1);
+    }
+    gidx = 0;
+    while ((line = paf_read_line(fp)) != NULL) {
+        // header lines
+        if (fp->buf.l > 0 && line[0] == '#') continue;
+
+        fields = parse_interval(fp->buf.l, line, &qname, &qbeg, &qend, &tname, &tbeg, &tend, &qbol, &qeol, &tbol, &teol);
+        
+        if (fields < 6) {
+            fprintf(stderr, "[W::%s] error reading interval line: %s...\n", __func__, line);
+            continue;
+        }
+
+        // sequence lengths are filled in when sequences are loaded
+        kv_push(interval_t, *intervals, ((interval_t){sd_put(qdicts, qname, 0), sd_put(tdicts, tname, 0), 
+                    qbeg, qend, tbeg, tend, qbol, qeol, tbol, teol, gidx}));
+        ++gidx;
+    }
+    paf_close(fp);
+}
+
+typedef struct {
+    int64 cost;
+    int64 idx;
+} shard_t;
+
+static int CORDER(const void *a, const void *b)
+{
+    // decreasing cost then increasing index
+    shard_t *x = (shard_t *) a;
+    shard_t *y = (shard_t *) b;
+    if (x->cost != y->cost)
+        return (x->cost < y->cost) - (x->cost > y->cost);
+    return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+static inline int shard_lt(shard_t *x, shard_t *y)
+{
+    return x->cost < y->cost || (x->cost == y->cost && x->idx < y->idx);
+}
+
+static void shard_intervals(interval_v *intervals, int shard_i, int shard_n)
+{
+    // longest-processing-time-first assignment by estimated cost
+    // ties are broken by interval and shard indices so that all shards agree
+    int64 i, j, k, n;
+    shard_t *costs, *heap, t;
+    uint8 *keep;
+
+    n = intervals->n;
+    MYMALLOC(costs, n);
+    MYMALLOC(heap, shard_n);
+    MYCALLOC(keep, n);
+    if ((n && (costs == NULL || keep == NULL)) || heap == NULL)
+        mem_alloc_error("shard costs");
+    for (i = 0; i < n; i++) {
+        interval_t *iv = &intervals->a[i];
+        costs[i].cost = (iv->qend - iv->qbeg) * (iv->tend - iv->tbeg) + FILL_FIXED_COST;
+        costs[i].idx  = i;
+    }
+    qsort(costs, n, sizeof(shard_t), CORDER);
+    // min-heap of shard loads
+    for (i = 0; i < shard_n; i++)
+        heap[i] = (shard_t) {0, i};
+    for (i = 0; i < n; i++) {
+        if (heap[0].idx == shard_i) keep[costs[i].idx] = 1;
+        heap[0].cost += costs[i].cost;
+        j = 0;
+        while ((k = (j<<1) + 1) < shard_n) {
+            if (k + 1 < shard_n && shard_lt(&heap[k+1], &heap[k])) ++k;
+            if (!shard_lt(&heap[k], &heap[j])) break;
+            t = heap[j], heap[j] = heap[k], heap[k] = t;
+            j = k;
+        }
+    }
+    for (i = j = 0; i < n; i++)
+        if (keep[i]) intervals->a[j++] = intervals->a[i];
+    fprintf(stderr, "[M::%s] shard %d/%d: %lld of %lld intervals\n", __func__, shard_i, shard_n, j, n);
+    intervals->n = j;
+    free(costs);
+    free(heap);
+    free(keep);
+}
+
+static void load_sequences(const char *fn, sdict_t *dicts, interval_v *intervals, int is_query)
+{
+    // only load the sequences the intervals need
+    // lengths recorded in a binary interval file must match the loaded sequences
+    uint8 *need;
+    uint32 i, n, *lens;
+    int64 j;
+
+    MYCALLOC(need, dicts->n);
+    MYMALLOC(lens, dicts->n);
+    if (dicts->n && (need == NULL || lens == NULL))
+        mem_alloc_error("sequence mask");
+    for (j = 0; j < (int64) intervals->n; j++)
+        need[is_query? intervals->a[j].qsid : intervals->a[j].tsid] = 1;
+    for (i = 0; i < dicts->n; i++)
+        lens[i] = dicts->s[i].len;
+    n = sd_load_fa(dicts, fn, need);
+    for (i = 0; i < dicts->n; i++) {
+        if (need[i] && dicts->s[i].seq == NULL) {
+            fprintf(stderr, "[E::%s] %s sequence not found: %s\n", __func__, is_query? "query" : "target", dicts->s[i].name);
+            exit (1);
+        }
+        if (need[i] && lens[i] && lens[i] != dicts->s[i].len) {
+            fprintf(stderr, "[E::%s] %s sequence %s has length %u, not %u as in the intervals\n", __func__,
+                is_query? "query" : "target", dicts->s[i].name, dicts->s[i].len, lens[i]);
+            exit (1);
+        }
+    }
+    fprintf(stderr, "[M::%s] loaded %u %s sequences\n", __func__, n, is_query? "query" : "target");
+    free(need);
+    free(lens);
+}
+
+static void check_intervals(interval_v *intervals, sdict_t *qdicts, sdict_t *tdicts)
+{
+    int64 i, n, qlen, tlen;
+    interval_t *iv;
+    for (i = n = 0; i < (int64) intervals->n; i++) {
+        iv = &intervals->a[i];
+        qlen = qdicts->s[iv->qsid].len;
+        tlen = tdicts->s[iv->tsid].len;
+        if (iv->qbeg < iv->qbol || iv->qend + iv->qeol > qlen || iv->tbeg < iv->tbol || iv->tend + iv->teol > tlen) {
+            fprintf(stderr, "[W::%s] skip invalid gap: %s[%lld]:%lld[%d]-%lld[%d] x %s[%lld]:%lld[%d]-%lld[%d]\n", 
+                __func__, qdicts->s[iv->qsid].name, qlen, iv->qbeg, iv->qbol, iv->qend, iv->qeol, 
+                tdicts->s[iv->tsid].name, tlen, iv->tbeg, iv->tbol, iv->tend, iv->teol);
+            continue;
+        }
+        intervals->a[n++] = *iv;
+    }
+    intervals->n = n;
+}
+
+static data_t *fill_init(const char *workdir, const char *lazexec, const char *lazopts, int n_threads, int n_jobs, sdict_t *qdicts, sdict_t *tdicts)
+{
+    // per-thread temporary output files; per-slot input files and lastz commands
+    int i, fd, n_slots;
+    char *template;
+    kstring_t buf = {0, 0, 0};
+    data_t *data;
+
+    n_slots = MAX(n_threads, n_jobs);
+    MYCALLOC(data, 1);
+    data->n_threads = n_threads;
+    data->n_slots = n_slots;
+    MYCALLOC(data->tmpfds, n_threads);
+    MYCALLOC(data->cmds, n_slots);
+    MYCALLOC(data->tfiles, n_slots);
+    MYCALLOC(data->qfiles, n_slots);
+    MYCALLOC(data->pfiles, n_slots);
+    if (data->tmpfds == NULL || data->cmds == NULL || data->tfiles == NULL || data->qfiles == NULL || data->pfiles == NULL)
+        mem_alloc_error("thread files");
+    data->tdicts = tdicts;
+    data->qdicts = qdicts;
+
+    MYMALLOC(template, strlen(workdir)+35);
+    for (i = 0; i < n_slots; i++) {
+        sprintf(template, "%s/tempfileXXXXXX", workdir);
+        fd = mkstemp(template);
+        if (fd == -1) {
+            fprintf(stderr, "[E::%s] failed to make temporary file: %s\n", __func__, template);
+            exit (1);
+        }
+        if (i < n_threads) {
+            data->tmpfds[i] = fdopen(fd, "w+");
+            if (data->tmpfds[i] == NULL) {
+                fprintf(stderr, "[E::%s] failed to open file to write: %s\n", __func__, template);
+                close(fd);
+                exit (1);
+            }
+        } else close(fd);
+        if (unlink(template) == -1) {
+            fprintf(stderr, "[E::%s] failed to remove temporary file %s\n", __func__, template);
+            if (i < n_threads) fclose(data->tmpfds[i]);
+            exit (1);
+        }
+        buf.l = 0; ksprintf(&buf, "%s_O.paf", template); data->pfiles[i] = strdup(buf.s);
+        buf.l = 0; ksprintf(&buf, "%s_A.fna", template); data->tfiles[i] = strdup(buf.s);
+        buf.l = 0; ksprintf(&buf, "%s_B.fna", template); data->qfiles[i] = strdup(buf.s);
+        buf.l = 0; ksprintf(&buf, "%s %s --output=%s %s %s", lazexec, lazopts, data->pfiles[i], data->tfiles[i], data->qfiles[i]);
+        data->cmds[i] = strdup(buf.s);
+    }
+    free(template);
+    free(buf.s);
+
+    if (VERBOSE > 0) {
+        for (i = 0; i < n_slots; i++) {
+            fprintf(stderr, "[M::%s] [slot %d] %s\n", __func__, i, data->tfiles[i]);
+            fprintf(stderr, "[M::%s] [slot %d] %s\n", __func__, i, data->qfiles[i]);
+            fprintf(stderr, "[M::%s] [slot %d] %s\n", __func__, i, data->pfiles[i]);
+            fprintf(stderr, "[M::%s] [slot %d] %s\n", __func__, i, data->cmds[i]);
+        }
+    }
+
+    return data;
+}
+
+static void fill_destroy(data_t *data)
+{
+    int i;
+    for (i = 0; i < data->n_threads; i++)
+        fclose(data->tmpfds[i]);
+    for (i = 0; i < data->n_slots; i++) {
+        free(data->tfiles[i]);
+        free(data->qfiles[i]);
+        free(data->pfiles[i]);
+        free(data->cmds[i]);
+    }
+    free(data->tmpfds);
+    free(data->tfiles);
+    free(data->qfiles);
+    free(data->pfiles);
+    free(data->cmds);
+    free(data->order);
+    free(data->tasks);
+    free(data);
+}
+
+static void fill_reset(data_t *data)
+{
+    // discard the results kept in the temporary files
+    int i;
+    for (i = 0; i < data->n_threads; i++) {
+        fflush(data->tmpfds[i]);
+        if (ftruncate(fileno(data->tmpfds[i]), 0) == -1) {
+            fprintf(stderr, "[E::%s] failed to truncate temporary file\n", __func__);
+            exit (1);
+        }
+        rewind(data->tmpfds[i]);
+    }
+}
+
+typedef struct {
+    uint32 tsid, qsid;
+    int64  tbeg, qbeg;
+    int64  idx;
+} skey_t;
+
+static int SORDER(const void *a, const void *b)
+{
+    skey_t *x = (skey_t *) a;
+    skey_t *y = (skey_t *) b;
+    if (x->tsid != y->tsid) return (x->tsid > y->tsid) - (x->tsid < y->tsid);
+    if (x->tbeg != y->tbeg) return (x->tbeg > y->tbeg) - (x->tbeg < y->tbeg);
+    if (x->qsid != y->qsid) return (x->qsid > y->qsid) - (x->qsid < y->qsid);
+    if (x->qbeg != y->qbeg) return (x->qbeg > y->qbeg) - (x->qbeg < y->qbeg);
+    return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+static void locality_order(data_t *data)
+{
+    // sort tasks by the position of their first interval, then lay the sorted list out
+    // so that the tasks kt_for() and claim_task() give thread t (t, t+T, ...) are a contiguous run
+    int64 i, j, t, n, n_t, *run;
+    int T = data->n_threads;
+    interval_t *iv;
+    skey_t *keys;
+    task_t *tasks;
+
+    n = data->n_tasks;
+    MYMALLOC(keys, n);
+    MYMALLOC(tasks, n);
+    MYMALLOC(run, T + 1);
+    if (keys == NULL || tasks == NULL || run == NULL)
+        mem_alloc_error("tasks");
+    for (i = 0; i < n; i++) {
+        iv = &data->intervals[data->order[data->tasks[i].beg]];
+        keys[i] = (skey_t) {iv->tsid, iv->qsid, iv->tbeg, iv->qbeg, i};
+    }
+    qsort(keys, n, sizeof(skey_t), SORDER);
+    // thread t owns ceil((n-t)/T) tasks
+    for (t = 0, run[0] = 0; t < T; t++) {
+        n_t = t < n? (n - t + T - 1) / T : 0;
+        run[t + 1] = run[t] + n_t;
+    }
+    for (j = 0; j < n; j++)
+        tasks[j] = data->tasks[keys[run[j % T] + j / T].idx];
+    memcpy(data->tasks, tasks, n * sizeof(task_t));
+    free(keys);
+    free(tasks);
+    free(run);
+}
+
+static void make_tasks(data_t *data, int64 n, int max_size, int max_group)
+{
+    // small intervals close on a target sequence are grouped into one lastz run, against a target
+    // slice spanning at most max_size; large intervals run on their own and are scheduled first
+    int64 i, j, k, n_small, tend;
+    interval_t *iv;
+    skey_t *keys;
+
+    MYREALLOC(data->order, MAX(n, 1));
+    MYREALLOC(data->tasks, MAX(n, 1));
+    MYMALLOC(keys, MAX(n, 1));
+    if (data->order == NULL || data->tasks == NULL || keys == NULL)
+        mem_alloc_error("tasks");
+
+    data->n_tasks = 0;
+    data->n_done = 0;
+    for (i = j = n_small = 0; i < n; i++) {
+        iv = &data->intervals[i];
+        if (max_size > 0 && max_group > 1 && iv->qend - iv->qbeg <= max_size && iv->tend - iv->tbeg <= max_size) {
+            keys[n_small++] = (skey_t) {iv->tsid, iv->qsid, iv->tbeg, iv->qbeg, i};
+        } else {
+            data->tasks[data->n_tasks++] = (task_t) {j, 1};
+            data->order[j++] = i;
+        }
+    }
+    qsort(keys, n_small, sizeof(skey_t), SORDER);
+    for (i = 0; i < n_small; i = k) {
+        tend = data->intervals[keys[i].idx].tend;
+        for (k = i + 1; k < n_small && k - i < max_group && keys[k].tsid == keys[i].tsid; k++) {
+            tend = MAX(tend, data->intervals[keys[k].idx].tend);
+            if (tend - keys[i].tbeg > max_size) break;
+        }
+        data->tasks[data->n_tasks++] = (task_t) {j, k - i};
+        for (; i < k; i++)
+            data->order[j++] = keys[i].idx;
+    }
+    free(keys);
+
+    if (data->locality && data->n_tasks > 1)
+        locality_order(data);
+
+    if (VERBOSE > 0)
+        fprintf(stderr, "[M::%s] %lld intervals in %lld lastz runs; %lld intervals batched\n", __func__, n, data->n_tasks, n_small);
+}
+
+static void write_output(data_t *data, int64 n, FILE *out)
+{
+    // write the per-interval blocks in interval order
+    int64 i, x, off, len;
+    char *buffer;
+    int fd;
+#define PUSH_BLOCK 0x100000
+    MYMALLOC(buffer, PUSH_BLOCK);
+    for (i = 0; i < data->n_threads; i++)
+        fflush(data->tmpfds[i]);
+    for (i = 0; i < n; i++) {
+        fd  = fileno(data->tmpfds[data->oblocks[i].tid]);
+        off = data->oblocks[i].off;
+        len = data->oblocks[i].len;
+        while (len > 0) {
+            x = pread(fd, buffer, MIN(len, PUSH_BLOCK), off);
+            if (x <= 0) {
+                fprintf(stderr, "[E::%s] failed to read temporary file\n", __func__);
+                exit (1);
+            }
+            fwrite(buffer, 1, x, out);
+            off += x;
+            len -= x;
+        }
+    }
+    free(buffer);
+#undef PUSH_BLOCK
+}
+
+static int64 merge_gidx(char *s, char **tag)
+{
+    char *p = strstr(s, "\tgi:i:");
+    if (p == NULL) return -1;
+    *tag = p;
+    return strtoll(p + 6, NULL, 10);
+}
+
+static int main_merge(int argc, char *argv[])
+{
+    int i, j, n;
+    paf_file_t **pfs;
+    char **lines, **tags;
+    int64 *gidxs;
+
+    if (argc < 2) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: alnfill merge shard1.paf[.gz] [shard2.paf[.gz] ...]\n");
+        fprintf(stderr, "Merges the outputs of 'alnfill --shard' runs in interval order\n\n");
+        return 1;
+    }
+
+    n = argc - 1;
+    MYCALLOC(pfs, n);
+    MYCALLOC(lines, n);
+    MYCALLOC(tags, n);
+    MYCALLOC(gidxs, n);
+    for (i = 0; i < n; i++) {
+        pfs[i] = paf_open(argv[i+1]);
+        if (!pfs[i]) {
+            fprintf(stderr, "[E::%s] cannot open paf file to read: %s\n", __func__, argv[i+1]);
+            exit (1);
+        }
+    }
+    // k-way merge; each shard output is in increasing interval order
+    for (i = 0; i < n; i++) {
+        lines[i] = paf_read_line(pfs[i]);
+        gidxs[i] = lines[i]? merge_gidx(lines[i], &tags[i]) : INT64_MAX;
+    }
+    for (;;) {
+        for (i = 0, j = -1; i < n; i++)
+            if (lines[i] && (j < 0 || gidxs[i] < gidxs[j])) j = i;
+        if (j < 0) break;
+        if (gidxs[j] < 0) {
+            fprintf(stderr, "[E::%s] missing interval tag in file %s: %s\n", __func__, argv[j+1], lines[j]);
+            exit (1);
+        }
+        *tags[j] = '\0';
+        fprintf(stdout, "%s\n", lines[j]);
+        lines[j] = paf_read_line(pfs[j]);
+        gidxs[j] = lines[j]? merge_gidx(lines[j], &tags[j]) : INT64_MAX;
+    }
+    for (i = 0; i < n; i++)
+        paf_close(pfs[i]);
+    free(pfs);
+    free(lines);
+    free(tags);
+    free(gidxs);
+
+    if (fflush(stdout) == EOF) {
+        fprintf(stderr, "[E::%s] failed to write the results\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+/********************************
+ * coordinator and worker modes *
+ ********************************/
+
+typedef struct {
+    int64 beg, end; // interval range
+    int   n_run, n_try;
+    int   done;
+    char *res;
+    int64 l_res;
+} batch_t;
+
+typedef struct {
+    int   fd;
+    int64 batch;    // batch running on the worker; -1 if none
+    int64 rbatch;   // batch of the result being received
+    int64 need;     // bytes of the result still to receive; -1 if reading a command
+    kstring_t ibuf;
+    kstring_t obuf;
+    size_t ooff;
+} client_t;
+
+typedef struct {
+    interval_v *intervals;
+    sdict_t *qdicts, *tdicts;
+    kvec_t(batch_t) batches;
+    kvec_t(int64) requeue;
+    kvec_t(client_t *) clients;
+    int64 head;     // next interval to put in a batch
+    int64 next_out; // next batch to write
+    int max_batch, max_try;
+} serve_t;
+
+static void serve_send_batch(serve_t *sv, client_t *cl, int64 b)
+{
+    int64 i;
+    interval_t *iv;
+    batch_t *bt = &sv->batches.a[b];
+    ++bt->n_run;
+    cl->batch = b;
+    ksprintf(&cl->obuf, "BATCH %lld %lld\n", b, bt->end - bt->beg);
+    for (i = bt->beg; i < bt->end; i++) {
+        iv = &sv->intervals->a[i];
+        ksprintf(&cl->obuf, "%lld\t%s\t%lld\t%lld\t%s\t%lld\t%lld\t%d\t%d\t%d\t%d\n", iv->gidx,
+            sv->qdicts->s[iv->qsid].name, iv->qbeg, iv->qend,
+            sv->tdicts->s[iv->tsid].name, iv->tbeg, iv->tend,
+            iv->qbol, iv->qeol, iv->tbol, iv->teol);
+    }
+}
+
+static void serve_get(serve_t *sv, client_t *cl)
+{
+    int64 b, i, n, remain;
+    batch_t *bt;
+
+    // retry batches of lost workers first
+    while (sv->requeue.n > 0) {
+        b = sv->requeue.a[--sv->requeue.n];
+        if (!sv->batches.a[b].done) {
+            serve_send_batch(sv, cl, b);
+            return;
+        }
+    }
+
+    // new batch; guided size shrinking as the queue drains
+    n = sv->intervals->n;
+    if (sv->head < n) {
+        remain = n - sv->head;
+        i = remain / (2 * MAX(sv->clients.n, 1));
+        i = MIN_MAX(i, 1, sv->max_batch);
+        kv_push(batch_t, sv->batches, ((batch_t) {sv->head, sv->head + i, 0, 0, 0, 0, 0}));
+        sv->head += i;
+        serve_send_batch(sv, cl, sv->batches.n - 1);
+        return;
+    }
+
+    // steal the oldest batch that is still running on a single worker
+    for (b = sv->next_out; b < (int64) sv->batches.n; b++) {
+        bt = &sv->batches.a[b];
+        if (!bt->done && bt->n_run == 1) {
+            if (VERBOSE > 0)
+                fprintf(stderr, "[M::%s] duplicate batch %lld [%lld, %lld)\n", __func__, b, bt->beg, bt->end);
+            serve_send_batch(sv, cl, b);
+            return;
+        }
+    }
+
+    kputs("WAIT\n", &cl->obuf);
+}
+
+static void serve_result(serve_t *sv, client_t *cl, int64 b, char *res, int64 l_res, FILE *out)
+{
+    batch_t *bt;
+    if (b < 0 || b >= (int64) sv->batches.n) {
+        fprintf(stderr, "[W::%s] result for unknown batch %lld\n", __func__, b);
+        free(res);
+        return;
+    }
+    bt = &sv->batches.a[b];
+    if (cl->batch == b) {
+        cl->batch = -1;
+        --bt->n_run;
+    }
+    if (bt->done) {
+        free(res);
+        return;
+    }
+    bt->done = 1;
+    bt->res = res;
+    bt->l_res = l_res;
+    // write results in batch order
+    while (sv->next_out < (int64) sv->batches.n && sv->batches.a[sv->next_out].done) {
+        bt = &sv->batches.a[sv->next_out];
+        fwrite(bt->res, 1, bt->l_res, out);
+        free(bt->res);
+        bt->res = 0;
+        ++sv->next_out;
+        if (sv->next_out % 100 == 0)
+            fprintf(stderr, "[M::%s] finished %lld batches, %lld intervals\n", __func__, sv->next_out, bt->end);
+    }
+}
+
+static void serve_lost(serve_t *sv, client_t *cl)
+{
+    batch_t *bt;
+    if (cl->batch < 0) return;
+    bt = &sv->batches.a[cl->batch];
+    --bt->n_run;
+    if (!bt->done && bt->n_run == 0) {
+        if (++bt->n_try > sv->max_try) {
+            fprintf(stderr, "[E::%s] batch %lld [%lld, %lld) failed %d times\n", __func__, cl->batch, bt->beg, bt->end, bt->n_try);
+            exit (1);
+        }
+        fprintf(stderr, "[W::%s] worker lost; requeue batch %lld [%lld, %lld)\n", __func__, cl->batch, bt->beg, bt->end);
+        kv_push(int64, sv->requeue, cl->batch);
+    }
+    cl->batch = -1;
+}
+
+static int serve_input(serve_t *sv, client_t *cl, FILE *out)
+{
+    // process the complete messages in the input buffer; -1 on protocol errors
+    char *p, *s;
+    size_t off = 0;
+    int64 b, n;
+    while (off < cl->ibuf.l) {
+        s = cl->ibuf.s + off;
+        if (cl->need < 0) {
+            p = memchr(s, '\n', cl->ibuf.l - off);
+            if (p == NULL) break;
+            *p = '\0';
+            if (strcmp(s, "GET") == 0) {
+                serve_get(sv, cl);
+            } else if (sscanf(s, "RES %lld %lld", &b, &n) == 2 && n >= 0) {
+                cl->rbatch = b;
+                cl->need = n;
+            } else {
+                fprintf(stderr, "[W::%s] invalid message from worker: %s\n", __func__, s);
+                return -1;
+            }
+            off = p + 1 - cl->ibuf.s;
+        }
+        if (cl->need >= 0) {
+            if ((int64) (cl->ibuf.l - off) < cl->need) break;
+            MYMALLOC(p, MAX(cl->need, 1));
+            if (p == NULL) mem_alloc_error("batch result");
+            memcpy(p, cl->ibuf.s + off, cl->need);
+            serve_result(sv, cl, cl->rbatch, p, cl->need, out);
+            off += cl->need;
+            cl->need = -1;
+        }
+    }
+    if (off > 0) {
+        memmove(cl->ibuf.s, cl->ibuf.s + off, cl->ibuf.l - off);
+        cl->ibuf.l -= off;
+    }
+    return 0;
+}
+
+static void serve_close(serve_t *sv, int64 k)
+{
+    client_t *cl = sv->clients.a[k];
+    serve_lost(sv, cl);
+    close(cl->fd);
+    free(cl->ibuf.s);
+    free(cl->obuf.s);
+    free(cl);
+    sv->clients.a[k] = sv->clients.a[--sv->clients.n];
+}
+
+static int main_serve(int argc, char *argv[])
+{
+    ketopt_t opt = KETOPT_INIT;
+    int c, lfd, fd;
+    int64 i, n_batch;
+    char buf[0x10000];
+    ssize_t x;
+    serve_t *sv;
+    client_t *cl;
+    struct pollfd *pfds;
+    interval_v intervals;
+    sdict_t *tdicts, *qdicts;
+    FILE *out = stdout;
+
+    MYCALLOC(sv, 1);
+    sv->max_batch = 64;
+    sv->max_try = 3;
+    while ((c = ketopt(&opt, argc, argv, 1, "b:r:o:v:", 0)) >= 0) {
+        if (c == 'b') sv->max_batch = atoi(opt.arg);
+        else if (c == 'r') sv->max_try = atoi(opt.arg);
+        else if (c == 'o') {
+            if (strcmp(opt.arg, "-") != 0 && (out = fopen(opt.arg, "wb")) == NULL) {
+                fprintf(stderr, "[ERROR]\033[1;31m failed to write the output to file '%s'\033[0m: %s\n", opt.arg, strerror(errno));
+                return 1;
+            }
+        }
+        else if (c == 'v') VERBOSE = atoi(opt.arg);
+        else {
+            fprintf(stderr, "[E::%s] unknown or missing option: \"%s\"\n", __func__, argv[opt.i - 1]);
+            return 1;
+        }
+    }
+    if (argc - opt.ind < 2) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: alnfill serve [options] intervals ADDR\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "  -b INT               max number of intervals per batch [%d]\n", sv->max_batch);
+        fprintf(stderr, "  -r INT               max number of retries of a batch [%d]\n", sv->max_try);
+        fprintf(stderr, "  -o FILE              write output to a file [stdout]\n");
+        fprintf(stderr, "  -v INT               verbose level [%d]\n", VERBOSE);
+        fprintf(stderr, "ADDR is either unix:PATH or [HOST]:PORT\n\n");
+        return 1;
+    }
+    positive_or_die(sv->max_batch);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    kv_init(intervals);
+    tdicts = sd_init();
+    qdicts = sd_init();
+    read_intervals(argv[opt.ind], qdicts, tdicts, &intervals);
+    fprintf(stderr, "[M::%s] number of intervals to serve: %ld\n", __func__, intervals.n);
+    sv->intervals = &intervals;
+    sv->qdicts = qdicts;
+    sv->tdicts = tdicts;
+
+    lfd = sock_listen(argv[opt.ind+1]);
+    if (lfd == -1) {
+        fprintf(stderr, "[E::%s] failed to listen on %s: %s\n", __func__, argv[opt.ind+1], strerror(errno));
+        exit (1);
+    }
+
+    pfds = 0;
+    for (;;) {
+        n_batch = sv->batches.n;
+        if (sv->head == (int64) intervals.n && sv->next_out == n_batch) {
+            // all done; let idle workers know there is nothing left, while those still running
+            // a duplicate batch are told once they report it, so that their result write succeeds
+            for (i = sv->clients.n - 1; i >= 0; i--) {
+                cl = sv->clients.a[i];
+                if (cl->batch >= 0 || cl->need >= 0) continue;
+                fcntl(cl->fd, F_SETFL, fcntl(cl->fd, F_GETFL) & ~O_NONBLOCK);
+                sock_write_all(cl->fd, "DONE\n", 5);
+                serve_close(sv, i);
+            }
+            if (sv->clients.n == 0)
+                break;
+        }
+        MYREALLOC(pfds, sv->clients.n + 1);
+        pfds[0].fd = lfd;
+        pfds[0].events = POLLIN;
+        for (i = 0; i < (int64) sv->clients.n; i++) {
+            cl = sv->clients.a[i];
+            pfds[i+1].fd = cl->fd;
+            pfds[i+1].events = POLLIN | (cl->obuf.l > cl->ooff? POLLOUT : 0);
+            pfds[i+1].revents = 0;
+        }
+        if (poll(pfds, sv->clients.n + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[E::%s] poll failed: %s\n", __func__, strerror(errno));
+            exit (1);
+        }
+        // clients are handled in reverse so that closing one does not move an unhandled one
+        for (i = sv->clients.n - 1; i >= 0; i--) {
+            cl = sv->clients.a[i];
+            if (pfds[i+1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                x = read(cl->fd, buf, sizeof(buf));
+                if (x < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+                if (x <= 0 || (kputsn(buf, x, &cl->ibuf), serve_input(sv, cl, out) < 0)) {
+                    serve_close(sv, i);
+                    continue;
+                }
+            }
+            if (cl->obuf.l > cl->ooff) {
+                x = write(cl->fd, cl->obuf.s + cl->ooff, cl->obuf.l - cl->ooff);
+                if (x < 0 && errno != EAGAIN && errno != EINTR) {
+                    serve_close(sv, i);
+                    continue;
+                }
+                if (x > 0) cl->ooff += x;
+                if (cl->ooff == cl->obuf.l) cl->obuf.l = cl->ooff = 0;
+            }
+        }
+        if (pfds[0].revents & POLLIN) {
+            fd = accept(lfd, 0, 0);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                MYCALLOC(cl, 1);
+                cl->fd = fd;
+                cl->batch = -1;
+                cl->need = -1;
+                kv_push(client_t *, sv->clients, cl);
+                if (VERBOSE > 0)
+                    fprintf(stderr, "[M::%s] worker connected; %ld workers\n", __func__, sv->clients.n);
+            }
+        }
+    }
+
+    close(lfd);
+    if (strncmp(argv[opt.ind+1], "unix:", 5) == 0)
+        unlink(argv[opt.ind+1] + 5);
+    fprintf(stderr, "[M::%s] finished %lld batches, %ld intervals\n", __func__, sv->next_out, intervals.n);
+
+    free(pfds);
+    kv_destroy(sv->batches);
+    kv_destroy(sv->requeue);
+    kv_destroy(sv->clients);
+    free(sv);
+    kv_destroy(intervals);
+    sd_destroy(tdicts);
+    sd_destroy(qdicts);
+
+    if (fflush(out) == EOF || (out != stdout && fclose(out))) {
+        fprintf(stderr, "[E::%s] failed to write the results\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+static int main_work(int argc, char *argv[])
+{
+    ketopt_t opt = KETOPT_INIT;
+    int c, n_threads, n_jobs, fields, max_size, max_group, locality;
+    int64 b, i, n, m, gidx, l_res;
+    char *workdir, *lazexec, *lazopts, *res, *p;
+    char line[BUFF_SIZE], *qname, *tname;
+    interval_v intervals;
+    interval_t iv;
+    sdict_t *tdicts, *qdicts;
+    data_t *data;
+    sock_t *sk;
+    FILE *out;
+    int fd;
+
+    workdir = "./";
+    lazexec = "lastz";
+    lazopts = "--format=PAF:wfmash --ambiguous=iupac";
+    n_threads = 1;
+    n_jobs = 0;
+    max_size = 0;
+    max_group = 32;
+    locality = 0;
+    while ((c = ketopt(&opt, argc, argv, 1, "t:j:w:z:b:n:sv:", 0)) >= 0) {
+        if (c == 't') n_threads = atoi(opt.arg);
+        else if (c == 'j') n_jobs = atoi(opt.arg);
+        else if (c == 'b') max_size = atoi(opt.arg);
+        else if (c == 'n') max_group = atoi(opt.arg);
+        else if (c == 's') locality = 1;
+        else if (c == 'w') workdir = opt.arg;
+        else if (c == 'z') lazexec = opt.arg;
+        else if (c == 'v') VERBOSE = atoi(opt.arg);
+        else {
+            fprintf(stderr, "[E::%s] unknown or missing option: \"%s\"\n", __func__, argv[opt.i - 1]);
+            return 1;
+        }
+    }
+    if (argc - opt.ind < 3) {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Usage: alnfill work [options] ref.fa[.gz] qry.fa[.gz] ADDR\n");
+        fprintf(stderr, "Options:\n");
+        fprintf(stderr, "  -t INT               number of threads [%d]\n", n_threads);
+        fprintf(stderr, "  -j INT               number of concurrent lastz runs [same as -t]\n");
+        fprintf(stderr, "  -w STR               work directory for temporary files [%s]\n", workdir);
+        fprintf(stderr, "  -z STR               lastz executable path [%s]\n", lazexec);
+        fprintf(stderr, "  -b INT               batch intervals within this target span into one lastz run; 0 for off [%d]\n", max_size);
+        fprintf(stderr, "  -n INT               max number of intervals per lastz run with -b [%d]\n", max_group);
+        fprintf(stderr, "  -s                   run intervals in target/query order, in contiguous runs per thread\n");
+        fprintf(stderr, "  -v INT               verbose level [%d]\n", VERBOSE);
+        fprintf(stderr, "ADDR is either unix:PATH or [HOST]:PORT\n\n");
+        return 1;
+    }
+    positive_or_die(n_threads);
+
+    signal(SIGPIPE, SIG_IGN);
+    check_executable(lazexec);
+
+    tdicts = make_sdict_from_fa(argv[opt.ind],   0);
+    qdicts = make_sdict_from_fa(argv[opt.ind+1], 0);
+
+    fd = sock_connect(argv[opt.ind+2]);
+    if (fd == -1) {
+        fprintf(stderr, "[E::%s] failed to connect to %s: %s\n", __func__, argv[opt.ind+2], strerror(errno));
+        exit (1);
+    }
+    sk = sock_open(fd);
+
+    data = fill_init(workdir, lazexec, lazopts, n_threads, n_jobs, qdicts, tdicts);
+    data->locality = locality;
+    kv_init(intervals);
+    m = 0;
+    for (;;) {
+        if (sock_write_all(fd, "GET\n", 4) || sock_read_line(sk, line, BUFF_SIZE) < 0)
+            break; // coordinator gone
+        if (strcmp(line, "DONE") == 0)
+            break;
+        if (strcmp(line, "WAIT") == 0) {
+            sleep(1);
+            continue;
+        }
+        if (sscanf(line, "BATCH %lld %lld", &b, &n) != 2) {
+            fprintf(stderr, "[E::%s] invalid message from coordinator: %s\n", __func__, line);
+            exit (1);
+        }
+
+        intervals.n = 0;
+        for (i = 0; i < n; i++) {
+            if (sock_read_line(sk, line, BUFF_SIZE) < 0) {
+                fprintf(stderr, "[E::%s] connection to coordinator lost\n", __func__);
+                exit (1);
+            }
+            gidx = strtoll(line, &p, 10);
+            fields = parse_interval(strlen(p), p, &qname, &iv.qbeg, &iv.qend, &tname, &iv.tbeg, &iv.tend, &iv.qbol, &iv.qeol, &iv.tbol, &iv.teol);
+            if (fields < 6) {
+                fprintf(stderr, "[E::%s] invalid interval from coordinator: %lld\n", __func__, gidx);
+                exit (1);
+            }
+            iv.qsid = sd_get(qdicts, qname);
+            iv.tsid = sd_get(tdicts, tname);
+            if (iv.qsid == UINT32_MAX || iv.tsid == UINT32_MAX) {
+                fprintf(stderr, "[E::%s] sequence not found: %s\n", __func__, iv.qsid == UINT32_MAX? qname : tname);
+                exit (1);
+            }
+            iv.gidx = gidx;
+            kv_push(interval_t, intervals, iv);
+        }
+        check_intervals(&intervals, qdicts, tdicts);
+
+        if (m < (int64) intervals.n) {
+            m = intervals.n;
+            MYREALLOC(data->oblocks, m);
+            if (data->oblocks == NULL)
+                mem_alloc_error("output blocks");
+        }
+        data->intervals = intervals.a;
+        make_tasks(data, intervals.n, max_size, max_group);
+        fill_run(data);
+
+        res = 0;
+        l_res = 0;
+        size_t l_out = 0;
+        out = open_memstream(&res, &l_out);
+        if (out == NULL) mem_alloc_error("batch result");
+        write_output(data, intervals.n, out);
+        fclose(out);
+        l_res = l_out;
+        fill_reset(data);
+
+        snprintf(line, BUFF_SIZE, "RES %lld %lld\n", b, l_res);
+        if (sock_write_all(fd, line, strlen(line)) || sock_write_all(fd, res, l_res)) {
+            fprintf(stderr, "[E::%s] connection to coordinator lost\n", __func__);
+            exit (1);
+        }
+        free(res);
+        if (VERBOSE > 0)
+            fprintf(stderr, "[M::%s] finished batch %lld of %lld intervals\n", __func__, b, n);
+    }
+    fprintf(stderr, "[M::%s] no more work\n", __func__);
+
+    sock_close(sk);
+    free(data->oblocks);
+    fill_destroy(data);
+    kv_destroy(intervals);
+    sd_destroy(tdicts);
+    sd_destroy(qdicts);
+    return 0;
+}
+
 static ko_longopt_t long_options[] = {
     { "verbose",        ko_required_argument, 'v' },
     { "version",        ko_no_argument,       'V' },
     { "help",           ko_no_argument,       'h' },
+    { "shard",          ko_required_argument, 300 },
+    { "jobs",           ko_required_argument, 'j' },
+    { "locality",       ko_no_argument,       's' },
     { 0, 0, 0 }
 };
 
 int main(int argc, char *argv[])
 {
-    const char *opt_str = "w:z:t:o:v:Vh";
+    const char *opt_str = "w:z:t:j:b:n:so:v:Vh";
     ketopt_t opt = KETOPT_INIT;
-    int c, i, ret = 0;
+    int c, ret = 0;
     int n_threads;
     FILE *fp_help;
-    kvec_t(interval_t) intervals;
+    interval_v intervals;
     sdict_t *tdicts, *qdicts;
-    char *workdir, *lazexec, *lazopts;
+    char *workdir, *lazexec, *lazopts, *p;
+    int shard_i, shard_n;
+    int max_size, max_group, n_jobs, locality;
 
     sys_init();
 
+    if (argc > 1 && strcmp(argv[1], "merge") == 0)
+        return main_merge(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "serve") == 0)
+        return main_serve(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "work") == 0)
+        return main_work(argc - 1, argv + 1);
+
     fp_help = stderr;
     workdir = "./";
     lazexec = "lastz";
     lazopts = "--format=PAF:wfmash --ambiguous=iupac";
     n_threads = 1;
+    n_jobs = 0;
+    shard_i = 0;
+    shard_n = 1;
+    max_size = 0;
+    max_group = 32;
+    locality = 0;
 
     while ((c = ketopt(&opt, argc, argv, 1, opt_str, long_options)) >=0) {
         if (c == 't') n_threads = atoi(opt.arg);
+        else if (c == 'j') n_jobs = atoi(opt.arg);
+        else if (c == 'b') max_size = atoi(opt.arg);
+        else if (c == 'n') max_group = atoi(opt.arg);
+        else if (c == 's') locality = 1;
+        else if (c == 300) {
+            shard_i = strtol(opt.arg, &p, 10);
+            shard_n = *p == '/'? strtol(p + 1, &p, 10) : 0;
+            if (*p != '\0' || shard_n < 1 || shard_i < 0 || shard_i >= shard_n) {
+                fprintf(stderr, "[E::%s] invalid shard specification: \"%s\"\n", __func__, opt.arg);
+                return 1;
+            }
+        }
         else if (c == 'w') workdir = opt.arg;
         else if (c == 'z') lazexec = opt.arg;
         else if (c == 'o') {
@@ -355,12 +1670,24 @@ int main(int argc, char *argv[])
         fprintf(fp_help, "Usage: alnfill [options] ref.fa[.gz] qry.fa[.gz] intervals\n");
         fprintf(fp_help, "Options:\n");
         fprintf(fp_help, "  -t INT               number of threads [%d]\n", n_threads);
+        fprintf(fp_help, "  -j INT               number of concurrent lastz runs [same as -t]\n");
         fprintf(fp_help, "  -w STR               work directory for temporary files [%s]\n", workdir);
         fprintf(fp_help, "  -z STR               lastz executable path [%s]\n", lazexec);
+        fprintf(fp_help, "  -b INT               batch intervals within this target span into one lastz run; 0 for off [%d]\n", max_size);
+        fprintf(fp_help, "  -n INT               max number of intervals per lastz run with -b [%d]\n", max_group);
+        fprintf(fp_help, "  -s, --locality       run intervals in target/query order, in contiguous runs per thread\n");
         fprintf(fp_help, "  -o FILE              write output to a file [stdout]\n");
+        fprintf(fp_help, "  --shard INT/INT      run shard i of N (0-based) of the cost-balanced intervals\n");
         fprintf(fp_help, "  -v INT               verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "  --version            show version number\n");
         fprintf(fp_help, "\n");
+        fprintf(fp_help, "       alnfill merge shard1.paf[.gz] [shard2.paf[.gz] ...]\n");
+        fprintf(fp_help, "  merge the outputs of '--shard' runs in interval order\n");
+        fprintf(fp_help, "       alnfill serve [options] intervals ADDR\n");
+        fprintf(fp_help, "  coordinate 'alnfill work' clients over a socket (unix:PATH or [HOST]:PORT)\n");
+        fprintf(fp_help, "       alnfill work [options] ref.fa[.gz] qry.fa[.gz] ADDR\n");
+        fprintf(fp_help, "  run the interval batches handed out by 'alnfill serve'\n");
+        fprintf(fp_help, "\n");
         fprintf(fp_help, "Example: ./alnfill -t 32 -o gapfill.paf ref.fa qry.fa intervals.txt\n\n");
         return fp_help == stdout? 0 : 1;
     }
@@ -372,137 +1699,35 @@ int main(int argc, char *argv[])
 
     check_executable(lazexec);
 
-    tdicts = make_sdict_from_fa(argv[opt.ind],   0);
-    qdicts = make_sdict_from_fa(argv[opt.ind+1], 0);
-
     kv_init(intervals);
-    gzFile fp;
-    kstream_t *ks;
-    kstring_t buf = {0, 0, 0};
-    char *qname, *tname;
-    uint32 tsid, qsid;
-    int64 qbeg, qend, tbeg, tend, tlen, qlen;
-    int qbol, qeol, tbol, teol;
-    int dret, fields;
-    fp = gzopen(argv[opt.ind+2], "r");
-    if (!fp) {
-        fprintf(stderr, "[E::%s] failed to open file %s to read\n", __func__, argv[opt.ind+2]);
-        exit (1);
-    }
-    ks = ks_init(fp);
-    while (ks_getuntil(ks, KS_SEP_LINE, &buf, &dret) >= 0) {
-        // header lines
-        if (buf.l > 0 && buf.s[0] == '#') continue;
-
-        fields = parse_interval(buf.l, buf.s, &qname, &qbeg, &qend, &tname, &tbeg, &tend, &qbol, &qeol, &tbol, &teol);
-        
-        if (fields < 6) {
-            fprintf(stderr, "[W::%s] error reading interval line: %s...\n", __func__, buf.s);
-            continue;
-        }
+    tdicts = sd_init();
+    qdicts = sd_init();
+    read_intervals(argv[opt.ind+2], qdicts, tdicts, &intervals);
+    if (shard_n > 1)
+        shard_intervals(&intervals, shard_i, shard_n);
 
-        qsid = sd_get(qdicts, qname);
-        if (qsid == UINT32_MAX) {
-            fprintf(stderr, "[E::%s] query sequence not found: %s\n", __func__, qname);
-            exit (1);
-        }
-        
-        tsid = sd_get(tdicts, tname);
-        if (tsid == UINT32_MAX) {
-            fprintf(stderr, "[E::%s] target sequence not found: %s\n", __func__, tname);
-            exit (1);
-        }
-        
-        qlen = qdicts->s[qsid].len;
-        tlen = tdicts->s[tsid].len;
-        if (qbeg < qbol || qend + qeol > qlen || tbeg < tbol || tend + teol > tlen) {
-            fprintf(stderr, "[W::%s] skip invalid gap: %s[%lld]:%lld[%d]-%lld[%d] x %s[%lld]:%lld[%d]-%lld[%d]\n", 
-                __func__, qname, qlen, qbeg, qbol, qend, qeol, tname, tlen, tbeg, tbol, tend, teol);
-            continue;
-        }
-
-        kv_push(interval_t, intervals, ((interval_t){qsid, tsid, qbeg, qend, tbeg, tend, qbol, qeol, tbol, teol}));
-    }
-    ks_destroy(ks);
-    gzclose(fp);
+    load_sequences(argv[opt.ind],   tdicts, &intervals, 0);
+    load_sequences(argv[opt.ind+1], qdicts, &intervals, 1);
+    check_intervals(&intervals, qdicts, tdicts);
 
     fprintf(stderr, "[M::%s] number of intervals to run: %ld\n", __func__, intervals.n);
 
-    char *cmds[n_threads], *qfiles[n_threads], *tfiles[n_threads], *pfiles[n_threads], *template;
-    FILE *tmpfds[n_threads];
-    MYMALLOC(template, strlen(workdir)+35);
-    for (i = 0; i < n_threads; i++) {
-        sprintf(template, "%s/tempfileXXXXXX", workdir);
-        int fd = mkstemp(template);
-        if (fd == -1) {
-            fprintf(stderr, "[E::%s] failed to make temporary file: %s\n", __func__, template);
-            exit (1);
-        }
-        tmpfds[i] = fdopen(fd, "w");
-        if (tmpfds[i] == NULL) {
-            fprintf(stderr, "[E::%s] failed to open file to write: %s\n", __func__, template);
-            close(fd);
-            exit (1);
-        }
-        if (unlink(template) == -1) {
-            fprintf(stderr, "[E::%s] failed to remove temporary file %s\n", __func__, template);
-            fclose(tmpfds[i]);
-            exit (1);
-        }
-        buf.l = 0; ksprintf(&buf, "%s_O.paf", template); pfiles[i] = strdup(buf.s);
-        buf.l = 0; ksprintf(&buf, "%s_A.fna", template); tfiles[i] = strdup(buf.s);
-        buf.l = 0; ksprintf(&buf, "%s_B.fna", template); qfiles[i] = strdup(buf.s);
-        buf.l = 0; ksprintf(&buf, "%s %s --output=%s %s %s", lazexec, lazopts, pfiles[i], tfiles[i], qfiles[i]);
-        cmds[i] = strdup(buf.s);
-    }
-    free(template);
-    free(buf.s);
-
-    if (VERBOSE > 0) {
-        for (i = 0; i < n_threads; i++) {
-            fprintf(stderr, "[M::%s] [thread %d] %s\n", __func__, i, tfiles[i]);
-            fprintf(stderr, "[M::%s] [thread %d] %s\n", __func__, i, qfiles[i]);
-            fprintf(stderr, "[M::%s] [thread %d] %s\n", __func__, i, pfiles[i]);
-            fprintf(stderr, "[M::%s] [thread %d] %s\n", __func__, i, cmds[i]);
-        }
-    }
-
     data_t *data;
-    MYCALLOC(data, 1);
+    data = fill_init(workdir, lazexec, lazopts, n_threads, n_jobs, qdicts, tdicts);
     data->intervals = intervals.a;
-    data->cmds = cmds;
-    data->tmpfds = tmpfds;
-    data->tfiles = tfiles;
-    data->qfiles = qfiles;
-    data->pfiles = pfiles;
-    data->tdicts = tdicts;
-    data->qdicts = qdicts;
+    data->tag_gidx = shard_n > 1;
+    data->locality = locality;
+    MYCALLOC(data->oblocks, intervals.n);
+    if (intervals.n && data->oblocks == NULL)
+        mem_alloc_error("output blocks");
+    make_tasks(data, intervals.n, max_size, max_group);
 
-    kt_for(n_threads, lastz_fill, data, intervals.n);
+    fill_run(data);
 
-#define PUSH_BLOCK 0x100000
-    char *buffer;
-    MYMALLOC(buffer, PUSH_BLOCK);
-    for (i = 0; i < n_threads; i++) {
-        FILE *pfile = tmpfds[i];
-        rewind(pfile);
-        int x = PUSH_BLOCK;
-        while (x >= PUSH_BLOCK)
-          { x = fread(buffer,1,PUSH_BLOCK,pfile);
-            if (x > 0)
-              fwrite(buffer,x,1,stdout);
-          }
-        fclose(pfile);
-    }
-    free(buffer);
+    write_output(data, intervals.n, stdout);
 
-    for (i = 0; i < n_threads; i++) {
-        free(data->tfiles[i]);
-        free(data->qfiles[i]);
-        free(data->pfiles[i]);
-        free(data->cmds[i]);
-    }
-    free(data);
+    free(data->oblocks);
+    fill_destroy(data);
     kv_destroy(intervals);
     sd_destroy(tdicts);
     sd_destroy(qdicts);
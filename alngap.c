@@ -32,16 +32,22 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
-#include <pthread.h>
+#include <ctype.h>
+#include <unistd.h>
 
 #include "ketopt.h"
 #include "kvec.h"
+#include "ksort.h"
 #include "kthread.h"
+#include "kalloc.h"
+#include "kstring.h"
 
 #include "paf.h"
+#include "onealn.h"
 #include "misc.h"
 #include "sdict.h"
-#include "rtree.h"
+#include "rangeset.h"
+#include "gapbin.h"
 
 #define ALNGAP_VERSION "0.1"
 
@@ -54,192 +60,686 @@ typedef struct {
     int    mlen;
 } aln_t;
 
+// alignments are stored in columns of 32-bit values
+enum {A_READ, B_READ, A_BPOS, A_EPOS, B_BPOS, B_EPOS, M_LEN, N_COLS};
+
+typedef struct {
+    int64   n, m;
+    uint32 *c[N_COLS];
+} alns_t;
+
 typedef struct {
     int64  abpos, aepos;
     int64  bbpos, bepos;
     int    abovl, aeovl;
     int    bbovl, beovl;
+    uint16 idy; // mean identity of the flanking alignments, scaled to 0xffff
     uint8  flag;
 } gap_t;
 
-typedef struct {
-    int beg;
-    int end;
-} range_t;
+static alns_t *alns_init(void)
+{
+    alns_t *alns;
+    MYCALLOC(alns, 1);
+    if (alns == NULL)
+        mem_alloc_error("alignments");
+    return alns;
+}
+
+static void alns_destroy(alns_t *alns)
+{
+    int k;
+    if (alns == NULL) return;
+    for (k = 0; k < N_COLS; k++)
+        free(alns->c[k]);
+    free(alns);
+}
+
+static void alns_resize(alns_t *alns, int64 m)
+{
+    int k;
+    for (k = 0; k < N_COLS; k++) {
+        MYREALLOC(alns->c[k], MAX(m, 1));
+        if (alns->c[k] == NULL)
+            mem_alloc_error("alignments");
+    }
+    alns->m = m;
+}
 
-aln_t *read_pafs(char **fs, int fn, sdict_t *qdicts, sdict_t *tdicts, int64 *_naln)
+static inline void alns_push(alns_t *alns, uint32 aread, uint32 bread, uint32 abpos, uint32 aepos, uint32 bbpos, uint32 bepos, uint32 mlen)
 {
+    int64 i;
+    if (alns->n == alns->m)
+        alns_resize(alns, alns->m? alns->m << 1 : 1<<16);
+    if (alns->n == UINT32_MAX) {
+        fprintf(stderr, "[E::%s] too many alignments\n", __func__);
+        exit (1);
+    }
+    i = alns->n++;
+    alns->c[A_READ][i] = aread;
+    alns->c[B_READ][i] = bread;
+    alns->c[A_BPOS][i] = abpos;
+    alns->c[A_EPOS][i] = aepos;
+    alns->c[B_BPOS][i] = bbpos;
+    alns->c[B_EPOS][i] = bepos;
+    alns->c[M_LEN][i]  = mlen;
+}
+
+static void alns_permute(alns_t *alns, const uint32 *perm)
+{
+    // reorder the columns one at a time: alns[i] <- alns[perm[i]]
+    // the spare column rotates into the set, so it takes the full capacity
+    int64 i, n = alns->n;
+    uint32 *tmp, *col;
+    int k;
+    MYMALLOC(tmp, MAX(alns->m, 1));
+    if (tmp == NULL)
+        mem_alloc_error("alignments");
+    for (k = 0; k < N_COLS; k++) {
+        col = alns->c[k];
+        for (i = 0; i < n; i++)
+            tmp[i] = col[perm[i]];
+        alns->c[k] = tmp;
+        tmp = col;
+    }
+    free(tmp);
+}
+
+static alns_t *alns_copy(const alns_t *alns)
+{
+    alns_t *copy = alns_init();
+    int k;
+    alns_resize(copy, alns->n);
+    for (k = 0; k < N_COLS; k++)
+        memcpy(copy->c[k], alns->c[k], sizeof(uint32) * alns->n);
+    copy->n = alns->n;
+    return copy;
+}
+
+static inline void alns_get(const alns_t *alns, int64 i, aln_t *aln)
+{
+    aln->aread = alns->c[A_READ][i];
+    aln->bread = alns->c[B_READ][i];
+    aln->abpos = alns->c[A_BPOS][i];
+    aln->aepos = alns->c[A_EPOS][i];
+    aln->bbpos = alns->c[B_BPOS][i];
+    aln->bepos = alns->c[B_EPOS][i];
+    aln->mlen  = alns->c[M_LEN][i];
+}
+
+#define PAF_BLOCK_SIZE 0x400000
+
+// --sorted: the alignments of a query are done as soon as the next query begins
+typedef struct {
+    int n_threads, do_rba;
+    int min_gap, max_gap, max_ovl;
+    double max_cov;
+    sdict_t *qdicts, *tdicts;
+    kvec_t(uint8) done;         // queries already done
+    rangeset_t *q_span, *t_span; // target coverage is kept for the run
+    int64 m_q, m_t;
+    int64 n_rec, n_sel, q_ns, q_nb;
+    int64 stats[4];
+} stream_t;
+
+static void stream_next(stream_t *st, alns_t *alns, uint32 qid);
+static void stream_flush(stream_t *st, alns_t *alns);
+
+// --max-mem: out-of-core mode; runs of alignments are spilled to temporary files, then merged
+typedef struct {
+    uint32 aread, bread, abpos, aepos, bbpos, bepos, mlen, idx;
+} xrec_t;
+
+typedef struct {
+    int n, m;
+    FILE **fp;
+    int *lv; // merge level: the number of times the records were rewritten
+} xruns_t;
+
+typedef struct {
+    const char *dir;
+    int64 cap;    // alignments held in memory
+    int n_threads, do_rba, binary;
+    int64 n_in;   // alignments spilled
+    xruns_t mruns; // runs in mlen order
+    xruns_t gruns; // runs in group order
+} ext_t;
+
+static void ext_spill(ext_t *ext, alns_t *alns);
+
+// filters applied to each record as it is parsed, so that rejected records never enter alns
+typedef struct {
+    uint32 min_blen, min_mapq;
+    double min_idy;
+    sdict_t *incl, *excl; // NULL for no list; names are checked on both query and target
+} paf_filter_t;
+
+typedef struct {
+    char **fs;
+    int fn, fi;
+    int n_threads;
+    const paf_filter_t *flt; // NULL for no filtering
+    int64 n_drop;
     paf_file_t *paf;
-    paf_rec_t _rec, *rec;
-    uint32 qid, tid;
-    kvec_t(aln_t) alns;
+    onealn_file_t *one;
+    sdict_t *qdicts;
+    sdict_t *tdicts;
+    uint32 qid, tid; // of the last record
+    kstring_t name;
+    alns_t *alns;
+    stream_t *st; // NULL unless streaming
+    ext_t *ext;   // NULL unless spilling
+} pl_paf_t;
+
+typedef struct {
+    int n, m;
+    int64 l_buf, m_buf;
+    const char **lines; // point into buf, or into the mapped file
+    int *lens;
+    int64 *offs; // offsets in buf of copied lines; -1 for mapped lines
+    char *buf; // copies of lines read through zlib
+    paf_rec_t *recs;
+    int *rets;
+    int n_eof;
+    paf_file_t *eofs[4]; // files finished in this block; closed once the block is consumed
+    onealn_file_t *one_eof; // .1aln blocks hold decoded records whose names belong to the file
+    const paf_filter_t *flt;
+} paf_block_t;
+
+static int paf_filter_name(const sdict_t *d, const char *name, uint32 l)
+{
+    // names from paf_split() are not NULL terminated
+    char buf[256], *s;
+    uint32 i;
+    s = l < sizeof(buf)? buf : malloc(l + 1);
+    if (s == NULL)
+        mem_alloc_error("name buffer");
+    memcpy(s, name, l);
+    s[l] = '\0';
+    i = sd_get((sdict_t *) d, s);
+    if (s != buf) free(s);
+    return i != UINT32_MAX;
+}
+
+static int paf_filter_pass(const paf_filter_t *flt, const paf_rec_t *r)
+{
+    if (r->bl < flt->min_blen || r->mq < flt->min_mapq)
+        return 0;
+    if (flt->min_idy > 0 && (r->bl == 0 || (double) r->ml < flt->min_idy * r->bl))
+        return 0;
+    if (flt->incl && (!paf_filter_name(flt->incl, r->qn, r->qnl) || !paf_filter_name(flt->incl, r->tn, r->tnl)))
+        return 0;
+    if (flt->excl && (paf_filter_name(flt->excl, r->qn, r->qnl) || paf_filter_name(flt->excl, r->tn, r->tnl)))
+        return 0;
+    return 1;
+}
+
+static void paf_block_parse(void *_b, long i, int tid)
+{
+    // on return: <0 for failure; 0 for success; >0 for filtered, as paf_parse()
+    paf_block_t *b = (paf_block_t *) _b;
+    if (b->lines)
+        b->rets[i] = paf_split(b->lens[i], b->lines[i], &b->recs[i]);
+    if (b->rets[i] == 0 && b->flt && !paf_filter_pass(b->flt, &b->recs[i]))
+        b->rets[i] = 1;
+}
+
+static void paf_block_destroy(paf_block_t *b)
+{
+    // mapped lines are released run by run so that the mapping does not stay resident
+    const char *beg, *end;
     int i;
+    for (i = 0, beg = end = NULL; b->lines && i <= b->n; i++) {
+        if (i < b->n && b->offs[i] >= 0) continue;
+        if (i == b->n || beg == NULL || b->lines[i] < end || b->lines[i] > end + 2) {
+            if (beg) paf_release(beg, end);
+            if (i == b->n) break;
+            beg = b->lines[i];
+        }
+        end = b->lines[i] + b->lens[i];
+    }
+    for (i = 0; i < b->n_eof; i++)
+        paf_close(b->eofs[i]);
+    onealn_close(b->one_eof);
+    free(b->lines);
+    free(b->lens);
+    free(b->offs);
+    free(b->buf);
+    free(b->recs);
+    free(b->rets);
+    free(b);
+}
 
-    kv_init(alns);
-    kv_resize(aln_t, alns, 1<<24);
-    rec = &_rec;
-    for (i = 0; i < fn; i++) {
-        paf = paf_open(fs[i]);
-        if (!paf) {
-            fprintf(stderr, "[E::%s] cannot open paf file to read: %s\n", __func__, fs[i]);
-            exit (1);
+static paf_block_t *paf_block_read(pl_paf_t *p)
+{
+    // read lines until the block is full, moving to the next file on EOF
+    // lines of uncompressed files are used in place, others are copied into the block
+    // records of .1aln files are decoded here; a block never mixes them with lines
+    paf_block_t *b;
+    const char *line;
+    int64 size;
+    int i, l;
+
+    MYCALLOC(b, 1);
+    if (b == NULL)
+        mem_alloc_error("paf block");
+    size = 0;
+    while (size < PAF_BLOCK_SIZE && b->n_eof < 4) {
+        if (p->paf == NULL && p->one == NULL) {
+            if (p->fi == p->fn) break;
+            if (onealn_is(p->fs[p->fi])) {
+                if (b->n > 0) break;
+                p->one = onealn_open(p->fs[p->fi]);
+                if (!p->one) {
+                    fprintf(stderr, "[E::%s] cannot open 1aln file to read: %s\n", __func__, p->fs[p->fi]);
+                    exit (1);
+                }
+            } else {
+                if (b->recs) break;
+                p->paf = paf_open(p->fs[p->fi]);
+                if (!p->paf) {
+                    fprintf(stderr, "[E::%s] cannot open paf file to read: %s\n", __func__, p->fs[p->fi]);
+                    exit (1);
+                }
+            }
+        }
+        if (p->one) {
+            if (b->n == b->m) {
+                b->m = b->m? b->m << 1 : 1024;
+                MYREALLOC(b->recs, b->m);
+                if (b->recs == NULL)
+                    mem_alloc_error("paf block");
+            }
+            if (onealn_read(p->one, &b->recs[b->n]) < 0) {
+                b->one_eof = p->one;
+                p->one = NULL;
+                p->fi++;
+                break;
+            }
+            b->n++;
+            size += sizeof(paf_rec_t);
+            continue;
         }
-        while (paf_read(paf, rec) >= 0) {
-            qid = sd_put(qdicts, rec->qn, rec->ql);
-            tid = sd_put(tdicts, rec->tn, rec->tl);
-            kv_push(aln_t, alns, ((aln_t){qid, tid, rec->qs, rec->qe, rec->ts, rec->te, rec->ml}));
-            if (alns.n % 1000000 == 0)
-                fprintf(stderr, "[M::%s] read %ld paf records\n", __func__, alns.n);
+        l = paf_next_line(p->paf, &line);
+        if (l < 0) {
+            b->eofs[b->n_eof++] = p->paf;
+            p->paf = NULL;
+            p->fi++;
+            continue;
         }
-        paf_close(paf);
+        if (b->n == b->m) {
+            b->m = b->m? b->m << 1 : 1024;
+            MYREALLOC(b->lines, b->m);
+            MYREALLOC(b->lens, b->m);
+            MYREALLOC(b->offs, b->m);
+            if (b->lines == NULL || b->lens == NULL || b->offs == NULL)
+                mem_alloc_error("paf block");
+        }
+        b->offs[b->n] = -1;
+        if (p->paf->map == NULL) {
+            if (b->l_buf + l + 1 > b->m_buf) {
+                b->m_buf = MAX(b->l_buf + l + 1, b->m_buf << 1);
+                MYREALLOC(b->buf, b->m_buf);
+                if (b->buf == NULL)
+                    mem_alloc_error("paf block");
+            }
+            memcpy(b->buf + b->l_buf, line, l + 1);
+            b->offs[b->n] = b->l_buf;
+            b->l_buf += l + 1;
+        }
+        b->lines[b->n] = line;
+        b->lens[b->n++] = l;
+        size += l + 1;
     }
-    fprintf(stderr, "[M::%s] read %ld paf records\n", __func__, alns.n);
-
-    MYREALLOC(alns.a, alns.n);
-
-    *_naln = alns.n;
-    return (alns.a);
+    if (b->n == 0 && b->n_eof == 0 && b->one_eof == NULL) {
+        paf_block_destroy(b);
+        return 0;
+    }
+    if (b->recs) {
+        MYCALLOC(b->rets, MAX(b->n, 1));
+        if (b->rets == NULL)
+            mem_alloc_error("paf block");
+        return b;
+    }
+    for (i = 0; i < b->n; i++)
+        if (b->offs[i] >= 0)
+            b->lines[i] = b->buf + b->offs[i];
+    return b;
 }
 
-typedef kvec_t(range_t) rangeset_t;
+static inline uint32 paf_name_put(sdict_t *d, uint32 last, const char *name, uint32 l, uint32 len, kstring_t *buf)
+{
+    // consecutive records mostly share the sequence names; names are not NULL terminated
+    if (last != UINT32_MAX && strncmp(d->s[last].name, name, l) == 0 && d->s[last].name[l] == '\0')
+        return last;
+    if (buf->m < l + 1) {
+        buf->m = l + 1;
+        MYREALLOC(buf->s, buf->m);
+        if (buf->s == NULL)
+            mem_alloc_error("name buffer");
+    }
+    memcpy(buf->s, name, l);
+    buf->s[l] = '\0';
+    return sd_put(d, buf->s, len);
+}
 
-static inline int overlap(int b1, int e1, int b2, int e2)
+static void *paf_pipeline(void *shared, int step, void *in)
 {
-    int max, min;
-    max = MAX(b1, b2);
-    min = MIN(e1, e2);
-    if (max < min)
-        return (min - max);
+    // step 0: read a block of lines; step 1: parse the lines in parallel; step 2: intern names and append
+    pl_paf_t *p = (pl_paf_t *) shared;
+    paf_block_t *b = (paf_block_t *) in;
+    paf_rec_t *rec;
+    uint32 qid;
+    int64 n0;
+    int i;
+
+    if (step == 0) {
+        return paf_block_read(p);
+    } else if (step == 1) {
+        if (b->rets == NULL) {
+            MYMALLOC(b->recs, MAX(b->n, 1));
+            MYMALLOC(b->rets, MAX(b->n, 1));
+            if (b->recs == NULL || b->rets == NULL)
+                mem_alloc_error("paf block");
+        } else if (p->flt == NULL) {
+            return b; // decoded from .1aln
+        }
+        b->flt = p->flt;
+        kt_for(p->n_threads, paf_block_parse, b, b->n);
+        return b;
+    } else if (step == 2) {
+        n0 = p->alns->n;
+        for (i = 0; i < b->n; i++) {
+            if (b->rets[i] != 0) {
+                if (b->rets[i] > 0) ++p->n_drop;
+                continue;
+            }
+            rec = &b->recs[i];
+            qid = paf_name_put(p->qdicts, p->qid, rec->qn, rec->qnl, rec->ql, &p->name);
+            if (p->st && qid != p->qid)
+                stream_next(p->st, p->alns, qid);
+            p->qid = qid;
+            p->tid = paf_name_put(p->tdicts, p->tid, rec->tn, rec->tnl, rec->tl, &p->name);
+            alns_push(p->alns, p->qid, p->tid, rec->qs, rec->qe, rec->ts, rec->te, rec->ml);
+            if (p->ext && p->alns->n == p->ext->cap)
+                ext_spill(p->ext, p->alns);
+        }
+        if (!p->st && p->alns->n / 1000000 > n0 / 1000000)
+            fprintf(stderr, "[M::%s] read %lld paf records\n", __func__, p->alns->n);
+        paf_block_destroy(b);
+    }
     return 0;
 }
 
-int find_last_small(range_t *ranges, int n, int val)
-{
-    int low = 0, high = n - 1, mid;
-    int res = -1;
-    while (low <= high) {
-        mid = low + (high - low) / 2;
-        if (ranges[mid].end < val) {
-            res = mid;
-            low = mid + 1;
-        } else
-            high = mid - 1;
-    }
-    return res;
-}
-
-int find_first_large(range_t *ranges, int n, int val)
-{
-    int low = 0, high = n - 1, mid;
-    int res = n;
-    while (low <= high) {
-        mid = low + (high - low) / 2;
-        if (ranges[mid].beg > val) {
-            res = mid;
-            high = mid - 1;
-        } else
-            low = mid + 1;
-    }
-    return res;
-}
-
-int rangeset_overlap(rangeset_t *spans, int beg, int end, int *_b, int *_e)
-{   
-    int b, e, o;
-    *_b = -1;
-    *_e = spans->n;
-    if (beg >= end || spans->n == 0) return 0;
-    b = find_last_small(spans->a, spans->n, beg);
-    e = find_first_large(spans->a, spans->n, end);
-    *_b = b;
-    *_e = e;
-    o = 0;
-    while (++b < e)
-        o += overlap(spans->a[b].beg, spans->a[b].end, beg, end);
-    return o;
-}
-
-void rangeset_add(rangeset_t *spans, int beg, int end, int b, int e)
-{
-    int nels;
-    if (beg >= end) return;
-    // expected number of elements
-    // left    :   b + 1
-    // overlap :   1
-    // right   :   spans->n - e
-    nels = spans->n + b - e + 2;
-    // span the rangeset if needed
-    if (spans->m < nels) 
-        kv_resize(range_t, *spans, nels);
-    if (b+1 < spans->n)
-        beg = MIN(spans->a[b+1].beg, beg);
-    if (e-1 < spans->n)
-        end = MAX(spans->a[e-1].end, end);
-    if (spans->n > e)
-        memmove(spans->a+b+2, spans->a+e, sizeof(range_t)*(spans->n-e));
-    spans->a[b+1] = (range_t) {beg, end};
-    spans->n = nels;
-}
-
-static int MORDER(const void *a, const void *b)
-{
-    int x, y;
-    x = ((aln_t *) a)->mlen;
-    y = ((aln_t *) b)->mlen;
-    return (x < y) - (x > y);
+alns_t *read_pafs(char **fs, int fn, sdict_t *qdicts, sdict_t *tdicts, int n_threads, const paf_filter_t *flt, stream_t *st, ext_t *ext)
+{
+    pl_paf_t pl;
+
+    memset(&pl, 0, sizeof(pl_paf_t));
+    pl.fs = fs;
+    pl.fn = fn;
+    pl.n_threads = n_threads;
+    pl.flt = flt;
+    pl.qdicts = qdicts;
+    pl.tdicts = tdicts;
+    pl.qid = pl.tid = UINT32_MAX;
+    pl.alns = alns_init();
+    pl.st = st;
+    pl.ext = ext;
+    if (ext)
+        alns_resize(pl.alns, ext->cap);
+
+    kt_pipeline(MIN(n_threads, 3), paf_pipeline, &pl, 3);
+    free(pl.name.s);
+    if (st && pl.alns->n > 0)
+        stream_flush(st, pl.alns);
+
+    fprintf(stderr, "[M::%s] read %lld paf records\n", __func__, st? st->n_rec : ext? ext->n_in + pl.alns->n : pl.alns->n);
+    if (flt)
+        fprintf(stderr, "[M::%s] %lld paf records filtered out\n", __func__, pl.n_drop);
+
+    if (!ext)
+        alns_resize(pl.alns, pl.alns->n);
+
+    return pl.alns;
+}
+
+typedef struct {
+    uint64 x, y;
+} pair64_t;
+
+#define u64_key(x) (x)
+#define pair64_x(p) ((p).x)
+#define pair64_y(p) ((p).y)
+KRADIX_SORT_INIT(u64, uint64, u64_key, 8)
+KRADIX_SORT_INIT(px, pair64_t, pair64_x, 8)
+KRADIX_SORT_INIT(py, pair64_t, pair64_y, 8)
+
+// parallel MSD radix sort: one in-place pass on the highest byte that differs, then the buckets in parallel
+#define RADIX_SORT_PAR_INIT(name, rstype_t, rskey) \
+    typedef struct { \
+        rstype_t *a; \
+        int64 *beg; \
+        int s; \
+    } rspar_##name##_t; \
+    static void rs_bucket_##name(void *_d, long i, int tid) \
+    { \
+        rspar_##name##_t *d = (rspar_##name##_t *) _d; \
+        int64 n = d->beg[i+1] - d->beg[i]; \
+        if (n > RS_MIN_SIZE && d->s > 0) rs_sort_##name(d->a + d->beg[i], d->a + d->beg[i+1], 8, d->s - 8); \
+        else if (n > 1) rs_insertsort_##name(d->a + d->beg[i], d->a + d->beg[i+1]); \
+    } \
+    static void radix_sort_par_##name(rstype_t *a, int64 n, int n_threads) \
+    { \
+        int64 i, beg[257], pos[256]; \
+        uint64 diff; \
+        int s, b; \
+        rstype_t tmp, swap; \
+        rspar_##name##_t d; \
+        if (n <= RS_MIN_SIZE) { \
+            if (n > 1) rs_insertsort_##name(a, a + n); \
+            return; \
+        } \
+        for (i = 1, diff = 0; i < n; i++) diff |= rskey(a[i]) ^ rskey(a[0]); \
+        if (diff == 0) return; \
+        s = (63 - __builtin_clzll(diff)) / 8 * 8; \
+        if (n_threads <= 1) { \
+            rs_sort_##name(a, a + n, 8, s); \
+            return; \
+        } \
+        memset(beg, 0, sizeof(beg)); \
+        for (i = 0; i < n; i++) ++beg[(rskey(a[i]) >> s & 0xff) + 1]; \
+        for (b = 0; b < 256; b++) beg[b+1] += beg[b], pos[b] = beg[b]; \
+        for (b = 0; b < 256; b++) { \
+            while (pos[b] < beg[b+1]) { \
+                tmp = a[pos[b]]; \
+                while ((int) (rskey(tmp) >> s & 0xff) != b) { \
+                    int c = rskey(tmp) >> s & 0xff; \
+                    swap = a[pos[c]], a[pos[c]++] = tmp, tmp = swap; \
+                } \
+                a[pos[b]++] = tmp; \
+            } \
+        } \
+        d.a = a, d.beg = beg, d.s = s; \
+        kt_for(n_threads, rs_bucket_##name, &d, 256); \
+    }
+
+RADIX_SORT_PAR_INIT(u64, uint64, u64_key)
+RADIX_SORT_PAR_INIT(px, pair64_t, pair64_x)
+
+static void pair64_sort_y(pair64_t *a, int64 n)
+{
+    // runs of pairs sorted by x are sorted by y
+    int64 i, j;
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && a[j].x == a[i].x; j++);
+        if (j - i > 1) radix_sort_py(a + i, a + j);
+    }
 }
 
 static void coverage_summary(rangeset_t *ranges, int n, int64 *_ns, int64 *_nb)
 {
-    int i, j;
-    int64 ns, nb;
-    range_t *range;
+    int i;
+    int64 ns, nb, ns1, nb1;
     ns = 0;
     nb = 0;
     for (i = 0; i < n; i++) {
-        ns += ranges[i].n;
-        range = ranges[i].a;
-        for (j = ranges[i].n; j; ) {
-            --j;
-            nb += range[j].end - range[j].beg;
-        }
+        rangeset_stats(&ranges[i], &ns1, &nb1);
+        ns += ns1;
+        nb += nb1;
     }
     *_ns = ns;
     *_nb = nb;
 }
 
-aln_t *reciprocal_best_aligns(aln_t *alns, int64 naln, sdict_t *qdicts, sdict_t *tdicts, double max_cov, int64 *_naln)
+static uint32 uf_find(uint32 *uf, uint32 x)
 {
-    aln_t *aln;
+    uint32 r = x, y;
+    while (uf[r] != r) r = uf[r];
+    while (uf[x] != r) y = uf[x], uf[x] = r, x = y;
+    return r;
+}
+
+typedef struct {
+    alns_t *alns;
+    uint32 *order; // alignments grouped by component, in mlen order within each
+    int64  *beg;   // component boundaries in order
+    int64  *n_sel; // selected per component
     rangeset_t *q_span, *t_span;
-    int qo, to, qs, qe, ts, te;
-    double mo;
-    int64 i, n_rec, ns, nb;
-    
-    fprintf(stderr, "[M::%s] selecting reciprocal best alignments from %lld records\n", __func__, naln);
+    double max_cov;
+} rba_t;
 
-    qsort(alns, naln, sizeof(aln_t), MORDER);
+static void rba_component(void *_d, long c, int tid)
+{
+    // the greedy selection restricted to one component; components share no sequence
+    rba_t *d = (rba_t *) _d;
+    alns_t *alns = d->alns;
+    uint32 *aread = alns->c[A_READ], *bread = alns->c[B_READ];
+    uint32 *abpos = alns->c[A_BPOS], *aepos = alns->c[A_EPOS];
+    uint32 *bbpos = alns->c[B_BPOS], *bepos = alns->c[B_EPOS];
+    uint32 *mlen  = alns->c[M_LEN], j;
+    rangeset_t *q_span = d->q_span, *t_span = d->t_span;
+    int64 qo, to;
+    double mo;
+    int64 i, n_rec;
 
-    MYCALLOC(q_span, qdicts->n + tdicts->n);
-    if (q_span == NULL)
-        mem_alloc_error("q&t spans");
-    t_span = q_span + qdicts->n;
     n_rec = 0;
-    for (i = 0; i < naln; i++) {
-        aln = alns + i;
-        qo = rangeset_overlap(q_span + aln->aread, aln->abpos, aln->aepos, &qs, &qe);
-        to = rangeset_overlap(t_span + aln->bread, aln->bbpos, aln->bepos, &ts, &te);
-        mo = aln->mlen * max_cov;
+    for (i = d->beg[c]; i < d->beg[c+1]; i++) {
+        j = d->order[i];
+        qo = rangeset_cover(q_span + aread[j], abpos[j], aepos[j]);
+        to = rangeset_cover(t_span + bread[j], bbpos[j], bepos[j]);
+        mo = mlen[j] * d->max_cov;
         if (qo <= mo && to <= mo) {
             // keep the alignment
-            rangeset_add(q_span + aln->aread, aln->abpos, aln->aepos, qs, qe);
-            rangeset_add(t_span + aln->bread, aln->bbpos, aln->bepos, ts, te);
+            rangeset_add(q_span + aread[j], abpos[j], aepos[j]);
+            rangeset_add(t_span + bread[j], bbpos[j], bepos[j]);
             ++n_rec;
-        } else aln->mlen = 0;
-        if ((i+1) % 1000000 == 0)
-            fprintf(stderr, "[M::%s] processed %lld records, %lld selected\n", __func__, i+1, n_rec);
+        } else mlen[j] = 0;
+    }
+    d->n_sel[c] = n_rec;
+}
+
+static void alns_compact(alns_t *alns)
+{
+    // drop the alignments not selected, i.e. those with mlen set to 0
+    uint32 *mlen = alns->c[M_LEN];
+    int64 i, n;
+    int k;
+    for (i = n = 0; i < alns->n; i++) {
+        if (mlen[i] == 0) continue;
+        for (k = 0; k < N_COLS; k++)
+            alns->c[k][n] = alns->c[k][i];
+        ++n;
     }
+    alns->n = n;
+}
+
+void reciprocal_best_aligns(alns_t *alns, sdict_t *qdicts, sdict_t *tdicts, double max_cov, int n_threads)
+{
+    // alignments only interact through a shared query or target sequence, so the connected components
+    // of the query-target sequence graph are processed in parallel, each in the global mlen order
+    rangeset_t *q_span, *t_span;
+    uint64 *perm;
+    uint32 *uf, *comp, *order, j, x, y, nq, nn, nc;
+    int64 *beg, *n_sel;
+    int64 i, naln, n_rec, ns, nb;
+    rba_t d;
+    
+    naln = alns->n;
+    fprintf(stderr, "[M::%s] selecting reciprocal best alignments from %lld records\n", __func__, naln);
+
+    // decreasing mlen then increasing index
+    MYMALLOC(perm, MAX(naln, 1));
+    if (perm == NULL)
+        mem_alloc_error("alignment order");
+    for (i = 0; i < naln; i++)
+        perm[i] = (uint64) (~alns->c[M_LEN][i]) << 32 | i;
+    radix_sort_par_u64(perm, naln, n_threads);
+
+    // connected components with union-find over query and target sequences
+    nq = qdicts->n;
+    nn = qdicts->n + tdicts->n;
+    MYMALLOC(uf, nn);
+    MYCALLOC(comp, nn);
+    if (uf == NULL || comp == NULL)
+        mem_alloc_error("components");
+    for (j = 0; j < nn; j++)
+        uf[j] = j;
+    for (i = 0; i < naln; i++) {
+        x = uf_find(uf, alns->c[A_READ][i]);
+        y = uf_find(uf, nq + alns->c[B_READ][i]);
+        if (x != y) uf[x] = y;
+    }
+    // component ids ordered by the first occurrence in mlen order, i.e. the best alignment
+    for (j = 0; j < nn; j++)
+        comp[j] = UINT32_MAX;
+    for (i = 0, nc = 0; i < naln; i++) {
+        x = uf_find(uf, alns->c[A_READ][(uint32) perm[i]]);
+        if (comp[x] == UINT32_MAX) comp[x] = nc++;
+    }
+    MYCALLOC(beg, nc + 1);
+    MYCALLOC(n_sel, MAX(nc, 1));
+    MYMALLOC(order, MAX(naln, 1));
+    if (beg == NULL || n_sel == NULL || order == NULL)
+        mem_alloc_error("components");
+    // stable counting sort of the mlen order by component
+    for (i = 0; i < naln; i++)
+        ++beg[comp[uf_find(uf, alns->c[A_READ][i])] + 1];
+    for (j = 0; j < nc; j++)
+        beg[j+1] += beg[j];
+    for (i = 0; i < naln; i++) {
+        j = (uint32) perm[i];
+        order[beg[comp[uf_find(uf, alns->c[A_READ][j])]]++] = j;
+    }
+    for (j = nc; j > 0; j--)
+        beg[j] = beg[j-1];
+    beg[0] = 0;
+    free(perm);
+    free(uf);
+    free(comp);
+    if (VERBOSE > 0)
+        fprintf(stderr, "[M::%s] %u connected components of query and target sequences\n", __func__, nc);
+
+    MYCALLOC(q_span, nn);
+    if (q_span == NULL)
+        mem_alloc_error("q&t spans");
+    t_span = q_span + qdicts->n;
+
+    d.alns = alns;
+    d.order = order;
+    d.beg = beg;
+    d.n_sel = n_sel;
+    d.q_span = q_span;
+    d.t_span = t_span;
+    d.max_cov = max_cov;
+    kt_for(n_threads, rba_component, &d, nc);
+
+    for (j = 0, n_rec = 0; j < nc; j++)
+        n_rec += n_sel[j];
     fprintf(stderr, "[M::%s] processed %lld records, %lld selected\n", __func__, naln, n_rec);
+    free(order);
+    free(beg);
+    free(n_sel);
 
     coverage_summary(q_span, qdicts->n, &ns, &nb);
     fprintf(stderr, "[M::%s] query genome covered with %lld segments of %lld bases\n", __func__, ns, nb);
@@ -247,250 +747,1062 @@ aln_t *reciprocal_best_aligns(aln_t *alns, int64 naln, sdict_t *qdicts, sdict_t
     fprintf(stderr, "[M::%s] target genome covered with %lld segments of %lld bases\n", __func__, ns, nb);
 
     for (i = qdicts->n + tdicts->n - 1; i >= 0; i--)
-        kv_destroy(q_span[i]);
+        rangeset_destroy(&q_span[i]);
     free(q_span);
 
-    n_rec = 0;
-    for (i = 0; i < naln; i++)
-        if (alns[i].mlen > 0)
-            alns[n_rec++] = alns[i];
-    *_naln = n_rec;
-    MYREALLOC(alns, n_rec);
-    
-    return alns;
+    alns_compact(alns);
+    alns_resize(alns, alns->n);
 }
 
+// alignments for the tie comparator below
+static alns_t *s_alns;
+
 static int RORDER(const void *a, const void *b)
 { 
-    int64  xm, ym;
-    aln_t *x = (aln_t *) a;
-    aln_t *y = (aln_t *) b;
-    
-    xm = x->aread;
-    ym = y->aread;
+    // by aread, bread, abpos, bbpos, aepos, bepos
+    static const int cols[] = {A_READ, B_READ, A_BPOS, B_BPOS, A_EPOS, B_EPOS};
+    uint32 i = *(uint32 *) a, j = *(uint32 *) b;
+    uint32 xm, ym;
+    int k;
+    for (k = 0; k < 6; k++) {
+        xm = s_alns->c[cols[k]][i];
+        ym = s_alns->c[cols[k]][j];
+        if (xm != ym) return ((xm > ym) - (xm < ym));
+    }
+    return 0;
+}
 
-    if (xm == ym) {
-        xm = x->bread;
-        ym = y->bread;
-    } else return ((xm > ym) - (xm < ym));
+typedef struct {
+    int64  aepos, bbpos, bepos;
+    uint32 idx;
+} akey_t;
 
-    if (xm == ym) {
-        xm = x->abpos;
-        ym = y->abpos;
-    } else return ((xm > ym) - (xm < ym));
+static int KORDER(const void *a, const void *b)
+{
+    // increasing aepos, then decreasing bbpos, increasing bepos and index: contained boxes come first
+    akey_t *x = (akey_t *) a;
+    akey_t *y = (akey_t *) b;
+    if (x->aepos != y->aepos) return (x->aepos > y->aepos) - (x->aepos < y->aepos);
+    if (x->bbpos != y->bbpos) return (x->bbpos < y->bbpos) - (x->bbpos > y->bbpos);
+    if (x->bepos != y->bepos) return (x->bepos > y->bepos) - (x->bepos < y->bepos);
+    return (x->idx > y->idx) - (x->idx < y->idx);
+}
 
-    if (xm == ym) {
-        xm = x->bbpos;
-        ym = y->bbpos;
-    } else return ((xm > ym) - (xm < ym));
+typedef kvec_t(akey_t) akey_v;
 
-    if (xm == ym) {
-        xm = x->aepos;
-        ym = y->aepos;
-    } else return ((xm > ym) - (xm < ym));
+static int64 anchor_prune(void *km, gap_t *gaps, int64 n, akey_v *keys, akey_v *stair)
+{
+    // candidates of one anchor share abpos; drop those containing another candidate of the anchor
+    // (or an identical earlier one), as they can never be minimal; the survivors keep their order
+    // boxes are taken by increasing aepos; stair holds the (bepos, bbpos) pairs seen so far that
+    // are not dominated, with bbpos increasing along bepos, so a box [bbpos, bepos] contains an
+    // earlier one iff the last pair with bepos' <= bepos has bbpos' >= bbpos
+    int64 i, j, lo, hi, mid, p;
+    akey_t *k, *st;
+
+    if (n < 2) return n;
+    if (keys->m < (size_t) n) {
+        keys->m = stair->m = n;
+        KREALLOC(km, keys->a, n);
+        KREALLOC(km, stair->a, n);
+        if (keys->a == NULL || stair->a == NULL)
+            mem_alloc_error("anchor keys");
+    }
+    for (i = 0; i < n; i++)
+        keys->a[i] = (akey_t) {gaps[i].aepos, gaps[i].bbpos, gaps[i].bepos, i};
+    qsort(keys->a, n, sizeof(akey_t), KORDER);
+    st = stair->a;
+    stair->n = 0;
+    for (i = 0; i < n; i++) {
+        k = &keys->a[i];
+        // p: last pair with bepos <= k->bepos
+        for (lo = 0, hi = stair->n - 1, p = -1; lo <= hi; ) {
+            mid = (lo + hi) / 2;
+            if (st[mid].bepos <= k->bepos) p = mid, lo = mid + 1;
+            else hi = mid - 1;
+        }
+        if (p >= 0 && st[p].bbpos >= k->bbpos) {
+            // zero-area boxes are left to the area-ordered filter, which keeps them unless identical
+            if ((k->aepos - gaps[k->idx].abpos) * (k->bepos - k->bbpos) > 0 ||
+                    (st[p].aepos == k->aepos && st[p].bbpos == k->bbpos && st[p].bepos == k->bepos))
+                gaps[k->idx].flag = 1;
+            continue;
+        }
+        // pairs from p+1 on with bbpos <= k->bbpos are dominated by the new one
+        for (j = p + 1; j < (int64) stair->n && st[j].bbpos <= k->bbpos; j++);
+        if (j > p + 1) {
+            memmove(st + p + 2, st + j, sizeof(akey_t) * (stair->n - j));
+            stair->n -= j - p - 2;
+        } else {
+            memmove(st + p + 2, st + p + 1, sizeof(akey_t) * (stair->n - p - 1));
+            stair->n += 1;
+        }
+        st[p + 1] = *k;
+    }
+    for (i = j = 0; i < n; i++) {
+        if (gaps[i].flag) continue;
+        gaps[j++] = gaps[i];
+    }
+    return j;
+}
+
+typedef struct {
+    pair64_t *keys;
+    int64 *beg;
+} gsort_t;
 
-    if (xm == ym) {
-        xm = x->bepos;
-        ym = y->bepos;
+static void group_sort(void *_d, long i, int tid)
+{
+    // order a group by abpos then index, and ties on abpos by RORDER
+    gsort_t *d = (gsort_t *) _d;
+    pair64_t *a = d->keys + d->beg[i];
+    int64 n = d->beg[i+1] - d->beg[i], j, k, l;
+    uint32 *idx;
+    radix_sort_py(a, a + n);
+    for (j = 0; j < n; j = k) {
+        for (k = j + 1; k < n && a[k].y>>32 == a[j].y>>32; k++);
+        if (k - j == 1) continue;
+        MYMALLOC(idx, k - j);
+        for (l = j; l < k; l++) idx[l - j] = (uint32) a[l].y;
+        qsort(idx, k - j, sizeof(uint32), RORDER);
+        for (l = j; l < k; l++) a[l].y = (a[l].y>>32<<32) | idx[l - j];
+        free(idx);
     }
-    return ((xm > ym) - (xm < ym));
 }
 
-static int AORDER(const void *a, const void *b)
-{ 
-    int64  xm, ym;
-    gap_t *x = (gap_t *) a;
-    gap_t *y = (gap_t *) b;
-    
-    xm = (x->aepos - x->abpos) * (x->bepos - x->bbpos);
-    ym = (y->aepos - y->abpos) * (y->bepos - y->bbpos);
-    
-    return ((xm > ym) - (xm < ym));
+static int alns_grouped(alns_t *alns)
+{
+    int64 i;
+    uint32 x, y;
+    s_alns = alns;
+    for (i = 1; i < alns->n; i++) {
+        x = i - 1, y = i;
+        if (RORDER(&x, &y) > 0) break;
+    }
+    s_alns = NULL;
+    return i >= alns->n;
+}
+
+static void alns_group_sort(alns_t *alns, int n_threads)
+{
+    // sort by RORDER: radix sort on (aread, bread) across threads, then each group on its own
+    // alignments already in order, e.g. for a later parameter set of --sweep, are left as they are
+    int64 i, j, n = alns->n;
+    pair64_t *keys;
+    uint32 *perm;
+    kvec_t(int64) beg;
+    gsort_t d;
+
+    if (alns_grouped(alns))
+        return;
+
+    MYMALLOC(keys, MAX(n, 1));
+    if (keys == NULL)
+        mem_alloc_error("alignment order");
+    for (i = 0; i < n; i++)
+        keys[i] = (pair64_t) {(uint64) alns->c[A_READ][i]<<32 | alns->c[B_READ][i], (uint64) alns->c[A_BPOS][i]<<32 | i};
+    radix_sort_par_px(keys, n, n_threads);
+
+    kv_init(beg);
+    for (i = 0; i < n; i = j) {
+        kv_push(int64, beg, i);
+        for (j = i + 1; j < n && keys[j].x == keys[i].x; j++);
+    }
+    kv_push(int64, beg, n);
+    s_alns = alns;
+    d.keys = keys, d.beg = beg.a;
+    kt_for(n_threads, group_sort, &d, beg.n - 1);
+    s_alns = NULL;
+    kv_destroy(beg);
+
+    // the permutation is written over the keys: perm[i] lies before keys[i]
+    perm = (uint32 *) keys;
+    for (i = 0; i < n; i++)
+        perm[i] = (uint32) keys[i].y;
+    alns_permute(alns, perm);
+    free(keys);
+}
+
+// minimal boxes are found offline: a box is dropped if it contains another box of the group
+// that comes before it in (area, index) order; boxes are mapped into dbox_t with pos being the
+// position in that order and rank the rank of y1 in decreasing order
+typedef struct {
+    int64  x1, x2, y1, y2;
+    uint32 pos, rank;
+} dbox_t;
+
+static int DORDER(const void *a, const void *b)
+{
+    // decreasing x1, then increasing x2, decreasing y1, increasing y2 and position:
+    // a box comes after all the boxes it contains, and identical boxes are adjacent
+    dbox_t *x = (dbox_t *) a;
+    dbox_t *y = (dbox_t *) b;
+    if (x->x1 != y->x1) return (x->x1 < y->x1) - (x->x1 > y->x1);
+    if (x->x2 != y->x2) return (x->x2 > y->x2) - (x->x2 < y->x2);
+    if (x->y1 != y->y1) return (x->y1 < y->y1) - (x->y1 > y->y1);
+    if (x->y2 != y->y2) return (x->y2 > y->y2) - (x->y2 < y->y2);
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+static int LORDER(const void *a, const void *b)
+{
+    // increasing x1 (the line), then decreasing y1
+    dbox_t *x = (dbox_t *) a;
+    dbox_t *y = (dbox_t *) b;
+    if (x->x1 != y->x1) return (x->x1 > y->x1) - (x->x1 < y->x1);
+    return (x->y1 < y->y1) - (x->y1 > y->y1);
+}
+
+static int PORDER(const void *a, const void *b)
+{
+    // increasing x1 (the line), then increasing position
+    dbox_t *x = (dbox_t *) a;
+    dbox_t *y = (dbox_t *) b;
+    if (x->x1 != y->x1) return (x->x1 > y->x1) - (x->x1 < y->x1);
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// Fenwick tree of prefix minima over ranks 1..n, bit[0] unused
+static inline void bit_put(int64 *bit, int64 n, int64 r, int64 v)
+{
+    for (; r <= n; r += r & -r)
+        if (bit[r] > v) bit[r] = v;
 }
 
-bool item_clone(const DATATYPE item, DATATYPE *into, void *udata) {return true;}
-void item_free(const DATATYPE item, void *udata) {};
+static inline void bit_clear(int64 *bit, int64 n, int64 r)
+{
+    for (; r <= n; r += r & -r)
+        bit[r] = INT64_MAX;
+}
+
+static inline int64 bit_min(int64 *bit, int64 r)
+{
+    int64 v = INT64_MAX;
+    for (; r > 0; r -= r & -r)
+        if (bit[r] < v) v = bit[r];
+    return v;
+}
+
+static void dom_cdq(dbox_t *a, dbox_t *t, int64 n, int64 *bit, int64 nr, uint8_t *dom, int64 nz)
+{
+    // a is in DORDER, so a box in the first half never contains one in the second half,
+    // and a box in the second half contains one in the first half iff x2, y1 and y2 nest;
+    // the boxes before nz (zero area) are only tested by dom_lines(); a is left sorted by x2
+    int64 i, j, k, m;
+    if (n < 2) return;
+    m = n / 2;
+    dom_cdq(a, t, m, bit, nr, dom, nz);
+    dom_cdq(a + m, t, n - m, bit, nr, dom, nz);
+    for (i = 0, j = m; j < n; j++) {
+        for (; i < m && a[i].x2 <= a[j].x2; i++)
+            bit_put(bit, nr, a[i].rank, a[i].y2);
+        if (a[j].pos >= nz && bit_min(bit, a[j].rank) <= a[j].y2)
+            dom[a[j].pos] = 1;
+    }
+    for (k = 0; k < i; k++)
+        bit_clear(bit, nr, a[k].rank);
+    for (i = 0, j = m, k = 0; i < m || j < n; ) {
+        if (j == n || (i < m && a[i].x2 <= a[j].x2)) t[k++] = a[i++];
+        else t[k++] = a[j++];
+    }
+    memcpy(a, t, sizeof(dbox_t) * n);
+}
+
+static void dom_lines(dbox_t *a, int64 n, int64 *bit, uint8_t *dom)
+{
+    // zero-area boxes lying on a line x1 = x2; a box only contains boxes on the same line,
+    // and is dropped only if a contained one comes earlier, so each line is swept by position
+    int64 i, j, k, r;
+    if (n < 2) return;
+    qsort(a, n, sizeof(dbox_t), LORDER);
+    for (i = 0; i < n; i = j) {
+        for (j = i, r = 0; j < n && a[j].x1 == a[i].x1; j++) {
+            if (j == i || a[j].y1 != a[j-1].y1) ++r;
+            a[j].rank = r;
+        }
+    }
+    qsort(a, n, sizeof(dbox_t), PORDER);
+    for (i = 0; i < n; i = j) {
+        for (j = i; j < n && a[j].x1 == a[i].x1; j++);
+        for (k = i; k < j; k++) {
+            if (bit_min(bit, a[k].rank) <= a[k].y2)
+                dom[a[k].pos] = 1;
+            bit_put(bit, j - i, a[k].rank, a[k].y2);
+        }
+        for (k = i; k < j; k++)
+            bit_clear(bit, j - i, a[k].rank);
+    }
+}
+
+static void dom_filter(void *km, gap_t *gaps, pair64_t *order, int64 n, int64 lo, int64 hi)
+{
+    // set flag for the boxes to keep; order lists the boxes by (area, index); only the boxes
+    // starting in [lo, hi) are decided, the others can only rule them out
+    int64 i, m, nr, nz;
+    gap_t *g;
+    dbox_t *a, *t;
+    int64 *bit;
+    uint8_t *dom;
+    pair64_t *ys;
+
+    KMALLOC(km, a, n);
+    KMALLOC(km, t, n);
+    KMALLOC(km, ys, n);
+    KMALLOC(km, bit, n + 1);
+    KCALLOC(km, dom, n);
+    if (!a || !t || !ys || !bit || !dom)
+        mem_alloc_error("gap filter");
+    for (i = 0; i <= n; i++)
+        bit[i] = INT64_MAX;
+
+    // boxes of zero area come first in order; among them the order decides
+    for (nz = 0; nz < n; nz++) {
+        g = &gaps[order[nz].y];
+        if ((g->aepos - g->abpos) * (g->bepos - g->bbpos) != 0)
+            break;
+    }
+    if (nz > 1) {
+        for (i = m = 0; i < nz; i++) {
+            g = &gaps[order[i].y];
+            if (g->aepos == g->abpos)
+                a[m++] = (dbox_t) {g->abpos, g->aepos, g->bbpos, g->bepos, i, 0};
+        }
+        dom_lines(a, m, bit, dom);
+        for (i = m = 0; i < nz; i++) {
+            g = &gaps[order[i].y];
+            if (g->bepos == g->bbpos)
+                a[m++] = (dbox_t) {g->bbpos, g->bepos, g->abpos, g->aepos, i, 0};
+        }
+        dom_lines(a, m, bit, dom);
+    }
+
+    // identical boxes: all but the first in order are dropped
+    for (i = 0; i < n; i++) {
+        g = &gaps[order[i].y];
+        a[i] = (dbox_t) {g->abpos, g->aepos, g->bbpos, g->bepos, i, 0};
+    }
+    qsort(a, n, sizeof(dbox_t), DORDER);
+    for (i = 1, m = 1; i < n; i++) {
+        if (a[i].x1 == a[m-1].x1 && a[i].x2 == a[m-1].x2 && a[i].y1 == a[m-1].y1 && a[i].y2 == a[m-1].y2)
+            dom[a[i].pos] = 1;
+        else a[m++] = a[i];
+    }
+
+    // rank y1 decreasingly, so that a prefix of ranks holds the boxes with y1' >= y1
+    for (i = 0; i < m; i++)
+        ys[i] = (pair64_t) {(uint64) a[i].y1 ^ 1ULL<<63, i};
+    radix_sort_px(ys, ys + m);
+    for (i = m - 1, nr = 0; i >= 0; i--) {
+        if (i == m - 1 || ys[i].x != ys[i+1].x) ++nr;
+        a[ys[i].y].rank = nr;
+    }
+
+    // a box of positive area contains no distinct box but a strictly smaller one, which comes
+    // earlier, so it is dropped iff it contains any other box; zero-area boxes are settled above
+    dom_cdq(a, t, m, bit, nr, dom, nz);
+    for (i = 0; i < n; i++) {
+        g = &gaps[order[i].y];
+        if (g->abpos >= lo && g->abpos < hi)
+            g->flag = !dom[i];
+    }
+
+    kfree(km, ys);
+    kfree(km, bit);
+    kfree(km, dom);
+    kfree(km, t);
+    kfree(km, a);
+}
 
-typedef kvec_t(aln_t) aln_v;
 typedef kvec_t(gap_t) gap_v;
 
+// --budget-area/--budget-cpu-hours: boxes are ranked by expected yield per cost and kept within the budget
+typedef struct {
+    double max_cost; // in DP cells
+    int64  fixed;    // cost of a box on top of its area
+} gap_budget_t;
+
+// --max-covered: the coverage of each sequence by all the input alignments
+typedef struct {
+    double max_frac;
+    uint32 n_q, n_t;
+    rangeset_t *q_cov, *t_cov;
+} gap_cover_t;
+
+typedef struct {
+    gapbin_rec_t r;
+    double yield; // expected aligned bases
+    double cost;
+    double value; // yield per cost
+    int64  idx;   // in group order
+} gap_pick_t;
+
 typedef struct {
     int min_gap, max_gap, max_ovl;
-    aln_t   *alns;
-    aln_v   *abufs;
-    gap_v   *gbufs;
+    int n_threads;
+    int binary; // gapbin_rec_t records instead of text lines
+    FILE    *fp;
+    const gap_budget_t *budget;
+    const gap_cover_t *cover;
+    int64 n_drop, n_trim; // boxes dropped or trimmed as covered
+    kstring_t picks; // gap_pick_t of all the boxes with a budget
+    alns_t  *alns;
+    void   **kms;
     uint64  *ranges;
+    int64    n_ranges, next;
+    int64    stats[4];
     sdict_t *tdicts;
     sdict_t *qdicts;
 } data_t;
 
-static pthread_mutex_t print_mutex;
+// the output of a group: formatted lines and the number, q/t bases and area of the boxes
+typedef struct {
+    kstring_t s;
+    int64 stats[4];
+    int64 n_drop, n_trim;
+} gap_out_t;
 
-static int64 b_stats[] = {0, 0, 0, 0};
+// groups [beg, end) are done in parallel, then written in order
+typedef struct {
+    data_t *data;
+    int64 beg, end;
+    gap_out_t *outs;
+} gap_batch_t;
+
+// alignments per batch
+#define GAP_BATCH_SIZE 0x100000
+
+// a worker arena grown beyond this is dropped after the group that grew it
+#define GAP_KM_MAX 0x10000000
+
+// groups with this many alignments are split into windows done in parallel: candidates
+// are found by windows of anchors, minimal boxes by windows along the query, and the
+// output is formatted by windows of the final order
+#ifndef GAP_SPLIT_SIZE
+#define GAP_SPLIT_SIZE  0x4000
+#endif
+#define GAP_WIN_ANCHORS 0x1000
+#define GAP_WIN_BOXES   0x4000
+
+static void km_check(data_t *data, int tid)
+{
+    // a huge group leaves a huge arena behind; give it back rather than keep it for the run
+    km_stat_t st;
+    km_stat(data->kms[tid], &st);
+    if (st.capacity > GAP_KM_MAX) {
+        km_destroy(data->kms[tid]);
+        data->kms[tid] = km_init();
+    }
+}
+
+static aln_t *gap_alns(data_t *data, long i, void *km, int64 *naln)
+{
+    // the alignments of group i, with the two sequence ends added as empty alignments
+    aln_t *alns;
+    int64 k, n = (uint32) data->ranges[i], off = data->ranges[i]>>32;
+    int64 alen, blen;
+    KMALLOC(km, alns, n + 2);
+    if (alns == NULL)
+        mem_alloc_error("alignment buffer");
+    for (k = 0; k < n; k++)
+        alns_get(data->alns, off + k, &alns[k + 1]);
+    alen = data->qdicts->s[alns[1].aread].len;
+    blen = data->tdicts->s[alns[1].bread].len;
+    alns[0] = (aln_t) {0, 0, 0, 0, 0, 0, 0};
+    alns[n+1] = (aln_t) {0, 0, alen, alen, blen, blen, 0};
+    *naln = n + 2;
+    return alns;
+}
 
-void gap_core(void *_data, long i, int tid)
+static inline double aln_identity(const aln_t *aln)
 {
-    data_t *data = (data_t *) _data;
+    // matches over the longer side; -1 for the empty alignments at the sequence ends
+    int64 l = MAX(aln->aepos - aln->abpos, aln->bepos - aln->bbpos);
+    return l > 0? MIN((double) aln->mlen / l, 1.0) : -1;
+}
+
+static void gap_find(data_t *data, aln_t *alns, int64 naln, int64 beg, int64 end, void *km, gap_v *gaps)
+{
+    // append the gap candidates anchored at alns[beg, end) to gaps
+    // every anchor is paired with all the alignments starting within max_gap of its end, so the
+    // scan is O(n*k) for k such alignments; anchor_prune() only bounds the candidates kept
     int max_gap = data->max_gap;
     int min_gap = data->min_gap;
     int max_ovl = data->max_ovl;
-    gap_v *gaps = &data->gbufs[tid];
-    int64  naln = (uint32) data->ranges[i];
-    aln_t *alns = data->abufs[tid].a;
-    memcpy(alns+1, data->alns+(data->ranges[i]>>32), sizeof(aln_t)*naln);
-    const char *qname = data->qdicts->s[alns[1].aread].name;
-    const char *tname = data->tdicts->s[alns[1].bread].name;
-
     int64 abpos1, aepos1, bbpos1, bepos1;
     int64 abpos2, aepos2, bbpos2, bepos2;
-    int64 alen, blen, bound, dist;
+    int64 bound, dist, n0;
+    double idy1, idy2;
     aln_t *aln1, *aln2, *aln1e, *aln2s, *aln2e;
+    akey_v keys = {0, 0, 0}, stair = {0, 0, 0};
 
-    // add two ends
-    alns[0] = (aln_t) {0, 0, 0, 0, 0, 0, 0};
-    alen = data->qdicts->s[alns[1].aread].len;
-    blen = data->tdicts->s[alns[1].bread].len;
-    alns[naln+1] = (aln_t) {0, 0, alen, alen, blen, blen, 0};
-    naln += 2;
-
-    // find gaps
-    gaps->n = 0;
     aln1e = alns + naln;
-    for (aln1 = alns; aln1 < aln1e; aln1++) {
+    for (aln1 = alns + beg; aln1 < alns + end; aln1++) {
         abpos1 = aln1->abpos;
         aepos1 = aln1->aepos;
         bbpos1 = aln1->bbpos;
         bepos1 = aln1->bepos;
+        idy1   = aln_identity(aln1);
         bound  = aepos1 + min_gap;
         aln2s  = aln1 + 1;
         while (aln2s < aln1e && aln2s->abpos < bound) {aln2s++;}
         bound  = aepos1 + max_gap;
         aln2e = aln2s;
         while (aln2e < aln1e && aln2e->abpos < bound) {aln2e++;}
+        n0 = gaps->n;
         for (aln2 = aln2s; aln2 < aln2e; aln2++) {
             abpos2 = aln2->abpos;
             aepos2 = aln2->aepos;
             bbpos2 = aln2->bbpos;
             bepos2 = aln2->bepos;
             dist   = (bbpos1>bbpos2? bbpos1 : bbpos2) - (bepos1<bepos2? bepos1 : bepos2);
-            if (dist >= min_gap && dist <= max_gap)
-                kv_push(gap_t, *gaps,
-                    ((gap_t) {
-                        (abpos1>aepos1-max_ovl)? abpos1 : (aepos1-max_ovl), 
-                        (aepos2<abpos2+max_ovl)? aepos2 : (abpos2+max_ovl), 
-                        (bepos1<bepos2? ((bbpos1>bepos1-max_ovl)? bbpos1 : (bepos1-max_ovl)) : ((bbpos2>bepos2-max_ovl)? bbpos2 : (bepos2-max_ovl))), 
-                        (bbpos1>bbpos2? ((bepos1<bbpos1+max_ovl)? bepos1 : (bbpos1+max_ovl)) : ((bepos2<bbpos2+max_ovl)? bepos2 : (bbpos2+max_ovl))),
-                        (abpos1>aepos1-max_ovl)? (aepos1-abpos1) : max_ovl, 
-                        (aepos2<abpos2+max_ovl)? (aepos2-abpos2) : max_ovl,
-                        (bepos1<bepos2? ((bbpos1>bepos1-max_ovl)? (bepos1-bbpos1) : max_ovl) : ((bbpos2>bepos2-max_ovl)? (bepos2-bbpos2) : max_ovl)), 
-                        (bbpos1>bbpos2? ((bepos1<bbpos1+max_ovl)? (bepos1-bbpos1) : max_ovl) : ((bepos2<bbpos2+max_ovl)? (bepos2-bbpos2) : max_ovl)), 
-                        0,
-                    }));
-        }
-    }
-    if (!gaps->n) return;
+            if (dist >= min_gap && dist <= max_gap) {
+                idy2 = aln_identity(aln2);
+                if (gaps->n == gaps->m) {
+                    KEXPAND(km, gaps->a, gaps->m);
+                    if (gaps->a == NULL)
+                        mem_alloc_error("gap buffer");
+                }
+                gaps->a[gaps->n++] = ((gap_t) {
+                    (abpos1>aepos1-max_ovl)? abpos1 : (aepos1-max_ovl), 
+                    (aepos2<abpos2+max_ovl)? aepos2 : (abpos2+max_ovl), 
+                    (bepos1<bepos2? ((bbpos1>bepos1-max_ovl)? bbpos1 : (bepos1-max_ovl)) : ((bbpos2>bepos2-max_ovl)? bbpos2 : (bepos2-max_ovl))), 
+                    (bbpos1>bbpos2? ((bepos1<bbpos1+max_ovl)? bepos1 : (bbpos1+max_ovl)) : ((bepos2<bbpos2+max_ovl)? bepos2 : (bbpos2+max_ovl))),
+                    (abpos1>aepos1-max_ovl)? (aepos1-abpos1) : max_ovl, 
+                    (aepos2<abpos2+max_ovl)? (aepos2-abpos2) : max_ovl,
+                    (bepos1<bepos2? ((bbpos1>bepos1-max_ovl)? (bepos1-bbpos1) : max_ovl) : ((bbpos2>bepos2-max_ovl)? (bepos2-bbpos2) : max_ovl)), 
+                    (bbpos1>bbpos2? ((bepos1<bbpos1+max_ovl)? (bepos1-bbpos1) : max_ovl) : ((bepos2<bbpos2+max_ovl)? (bepos2-bbpos2) : max_ovl)), 
+                    (uint16) (0xffff * (idy1 < 0? (idy2 < 0? 0 : idy2) : idy2 < 0? idy1 : (idy1 + idy2) / 2)),
+                    0,
+                });
+            }
+        }
+        gaps->n = n0 + anchor_prune(km, gaps->a + n0, gaps->n - n0, &keys, &stair);
+    }
+    kfree(km, keys.a);
+    kfree(km, stair.a);
+}
 
+static pair64_t *gap_order(void *km, gap_t *gaps, int64 n)
+{
     // only keep minimal bounding boxes, i. e., those spanning a single gap
-    qsort(gaps->a, gaps->n, sizeof(gap_t), AORDER); // sort by size
-    
-    gap_t *gap1, *gap1e;
-    struct rtree *gap_tr = rtree_new();
-    gap_tr->item_clone = item_clone;
-    gap_tr->item_free  = item_free;
-    for (gap1 = gaps->a, gap1e = gaps->a+gaps->n; gap1 < gap1e; gap1++) {
-        if (!rtree_exist_node_inside(gap_tr, (NUMTYPE[2]){gap1->abpos,gap1->bbpos}, (NUMTYPE[2]){gap1->aepos,gap1->bepos})) {
-            gap1->flag = 1;
-            rtree_insert(gap_tr, (NUMTYPE[2]){gap1->abpos,gap1->bbpos}, (NUMTYPE[2]){gap1->aepos,gap1->bepos}, NULL);
-        }
-    }
-    rtree_free(gap_tr);
-
-    // output gaps
-    pthread_mutex_lock(&print_mutex);
-    for (gap1 = gaps->a, gap1e = gaps->a+gaps->n; gap1 < gap1e; gap1++) {
-        if (gap1->flag == 0) continue;
-        b_stats[0] += 1;
-        b_stats[1] += gap1->aepos - gap1->abpos;
-        b_stats[2] += gap1->bepos - gap1->bbpos;
-        b_stats[3] += (gap1->aepos - gap1->abpos) * (gap1->bepos - gap1->bbpos);
-        fprintf(stdout, "%s\t%lld\t%lld\t%s\t%lld\t%lld\t%d\t%d\t%d\t%d\n", 
-            qname, gap1->abpos, gap1->aepos, 
-            tname, gap1->bbpos, gap1->bepos,
-            gap1->abovl, gap1->aeovl,
-            gap1->bbovl, gap1->beovl);
-    }
-    pthread_mutex_unlock(&print_mutex);
-}
-
-static int align_gaps(aln_t *alns, int64 naln, sdict_t *qdicts, sdict_t *tdicts, int n_threads, int min_gap, int max_gap, int max_ovl)
-{ 
+    // sort by size, ties in the order found
+    int64 k;
+    pair64_t *order;
+    KMALLOC(km, order, n);
+    if (order == NULL)
+        mem_alloc_error("gap order");
+    for (k = 0; k < n; k++)
+        order[k] = (pair64_t) {(uint64) ((gaps[k].aepos - gaps[k].abpos) * (gaps[k].bepos - gaps[k].bbpos)) ^ 1ULL<<63, k};
+    radix_sort_px(order, order + n);
+    pair64_sort_y(order, n);
+    return order;
+}
+
+static int cover_trim(const rangeset_t *cov, int64 *beg, int64 *end, int *bovl, int *eovl, double max_frac)
+{
+    // the gap between the flanks is [beg + bovl, end - eovl); 0 if it is covered beyond max_frac
+    // otherwise its covered ends are cut off, together with the flank overlap on that side
+    int64 b = *beg + *bovl, e = *end - *eovl, c, rb, re;
+    if (b >= e) return 1;
+    c = rangeset_cover(cov, b, e);
+    if (c > 0 && c >= max_frac * (e - b)) return 0;
+    if (rangeset_find(cov, b, &rb, &re)) {
+        if (re >= e) return 0;
+        *beg = re, *bovl = 0;
+    }
+    if (rangeset_find(cov, e - 1, &rb, &re))
+        *end = rb, *eovl = 0;
+    return 1;
+}
+
+#define GAP_FMT "%s\t%lld\t%lld\t%s\t%lld\t%lld\t%d\t%d\t%d\t%d\n"
+
+static void gap_format(data_t *data, gap_t *gaps, pair64_t *order, int64 n, uint32 qid, uint32 tid, gap_out_t *out)
+{
+    const char *qname = data->qdicts->s[qid].name, *tname = data->tdicts->s[tid].name;
+    const gap_cover_t *cv = data->cover;
+    int64 k, qs, ts;
+    gap_t *gap1, g;
+    gapbin_rec_t r;
+    gap_pick_t pick;
+    for (k = 0; k < n; k++) {
+        if (gaps[order[k].y].flag == 0) continue;
+        gap1 = &gaps[order[k].y];
+        if (cv) {
+            g = *gap1;
+            gap1 = &g;
+            if (!cover_trim(cv->q_cov + qid, &g.abpos, &g.aepos, &g.abovl, &g.aeovl, cv->max_frac) ||
+                    !cover_trim(cv->t_cov + tid, &g.bbpos, &g.bepos, &g.bbovl, &g.beovl, cv->max_frac)) {
+                out->n_drop++;
+                continue;
+            }
+            if (g.abpos != gaps[order[k].y].abpos || g.aepos != gaps[order[k].y].aepos ||
+                    g.bbpos != gaps[order[k].y].bbpos || g.bepos != gaps[order[k].y].bepos)
+                out->n_trim++;
+        }
+        out->stats[0] += 1;
+        out->stats[1] += gap1->aepos - gap1->abpos;
+        out->stats[2] += gap1->bepos - gap1->bbpos;
+        out->stats[3] += (gap1->aepos - gap1->abpos) * (gap1->bepos - gap1->bbpos);
+        r = (gapbin_rec_t) {qid, tid, gap1->abpos, gap1->aepos, gap1->bbpos, gap1->bepos,
+            gap1->abovl, gap1->aeovl, gap1->bbovl, gap1->beovl};
+        if (data->budget) {
+            // the yield is the shorter side, discounted by the flank identity and by the diagonal
+            // shift between the flanks, which shows as a difference between the sides
+            qs = gap1->aepos - gap1->abpos;
+            ts = gap1->bepos - gap1->bbpos;
+            pick.r = r;
+            pick.yield = qs > 0 && ts > 0? (double) MIN(qs, ts) * MIN(qs, ts) / MAX(qs, ts) * gap1->idy / 0xffff : 0;
+            pick.cost = (double) qs * ts + data->budget->fixed;
+            pick.value = pick.yield / MAX(pick.cost, 1);
+            pick.idx = 0;
+            kputsn((char *) &pick, sizeof(pick), &out->s);
+        } else if (data->binary) {
+            kputsn((char *) &r, sizeof(r), &out->s);
+        } else {
+            ksprintf(&out->s, GAP_FMT, qname, gap1->abpos, gap1->aepos, tname, gap1->bbpos, gap1->bepos,
+                gap1->abovl, gap1->aeovl, gap1->bbovl, gap1->beovl);
+        }
+    }
+}
+
+static void gap_group(data_t *data, long i, void *km, gap_out_t *out)
+{
+    // all the scratch space of a group comes from the worker arena km and goes back to it
+    gap_v  gaps = {0, 0, 0};
+    int64  naln;
+    aln_t *alns;
+    pair64_t *order;
+
+    alns = gap_alns(data, i, km, &naln);
+    gap_find(data, alns, naln, 0, naln, km, &gaps);
+    if (gaps.n > 0) {
+        order = gap_order(km, gaps.a, gaps.n);
+        dom_filter(km, gaps.a, order, gaps.n, INT64_MIN, INT64_MAX);
+        gap_format(data, gaps.a, order, gaps.n, alns[1].aread, alns[1].bread, out);
+        kfree(km, order);
+    }
+    kfree(km, gaps.a);
+    kfree(km, alns);
+}
+
+typedef struct {
+    data_t   *data;
+    aln_t    *alns;
+    int64     naln, n;
+    gap_v    *wgaps;  // candidates of each anchor window
+    gap_t    *gaps;   // all the candidates, in the order found
+    pair64_t *order;  // candidates by (area, index)
+    uint64   *rank;   // rank[k]: the position of candidate k in order
+    pair64_t *apos;   // candidates by abpos
+    int64    *wbeg;   // query window j holds apos[wbeg[j], wbeg[j+1])
+    gap_out_t *outs;  // formatted output of each window of order
+} gap_split_t;
+
+static void split_find(void *_s, long j, int tid)
+{
+    // anchor windows produce their candidates in the order the whole group would
+    gap_split_t *s = (gap_split_t *) _s;
+    int64 beg = j * GAP_WIN_ANCHORS, end = MIN(beg + GAP_WIN_ANCHORS, s->naln);
+    gap_find(s->data, s->alns, s->naln, beg, end, NULL, &s->wgaps[j]);
+}
+
+static void split_filter(void *_s, long j, int tid)
+{
+    // a box can only contain boxes starting between its own start and end, so the boxes of a
+    // window are decided with those starting up to the largest end in the window added; the
+    // order of the group is kept by taking the boxes by rank
+    gap_split_t *s = (gap_split_t *) _s;
+    void *km = s->data->kms[tid];
+    int64 k, beg = s->wbeg[j], end = s->wbeg[j+1], e, n, lo, hi, aend;
+    uint64 *pos;
+    pair64_t *sub;
+
+    lo = s->gaps[s->apos[beg].y].abpos;
+    hi = end < s->n? s->gaps[s->apos[end].y].abpos : INT64_MAX;
+    for (k = beg, aend = INT64_MIN; k < end; k++)
+        if (aend < s->gaps[s->apos[k].y].aepos)
+            aend = s->gaps[s->apos[k].y].aepos;
+    for (e = end; e < s->n && s->gaps[s->apos[e].y].abpos <= aend; e++);
+    n = e - beg;
+    KMALLOC(km, pos, n);
+    KMALLOC(km, sub, n);
+    if (pos == NULL || sub == NULL)
+        mem_alloc_error("gap window");
+    for (k = 0; k < n; k++)
+        pos[k] = s->rank[s->apos[beg + k].y];
+    radix_sort_u64(pos, pos + n);
+    for (k = 0; k < n; k++)
+        sub[k] = s->order[pos[k]];
+    dom_filter(km, s->gaps, sub, n, lo, hi);
+    kfree(km, sub);
+    kfree(km, pos);
+    km_check(s->data, tid);
+}
+
+static void split_format(void *_s, long j, int tid)
+{
+    gap_split_t *s = (gap_split_t *) _s;
+    int64 beg = j * GAP_WIN_BOXES, end = MIN(beg + GAP_WIN_BOXES, s->n);
+    gap_format(s->data, s->gaps, s->order + beg, end - beg, s->alns[1].aread, s->alns[1].bread, &s->outs[j]);
+}
+
+static void gap_group_split(data_t *data, long i, gap_out_t *out)
+{
+    gap_split_t s;
+    int64 j, k, nw;
+    int n_threads = data->n_threads;
+
+    memset(&s, 0, sizeof(gap_split_t));
+    s.data = data;
+    s.alns = gap_alns(data, i, NULL, &s.naln);
+
+    // candidates by windows of anchors, joined in order
+    nw = (s.naln + GAP_WIN_ANCHORS - 1) / GAP_WIN_ANCHORS;
+    MYCALLOC(s.wgaps, nw);
+    if (s.wgaps == NULL)
+        mem_alloc_error("gap windows");
+    kt_for(n_threads, split_find, &s, nw);
+    for (j = 0; j < nw; j++)
+        s.n += s.wgaps[j].n;
+    if (s.n == 0) {
+        free(s.wgaps);
+        free(s.alns);
+        return;
+    }
+    MYMALLOC(s.gaps, s.n);
+    if (s.gaps == NULL)
+        mem_alloc_error("gap buffer");
+    for (j = k = 0; j < nw; k += s.wgaps[j].n, j++) {
+        memcpy(s.gaps + k, s.wgaps[j].a, sizeof(gap_t) * s.wgaps[j].n);
+        free(s.wgaps[j].a);
+    }
+    free(s.wgaps);
+
+    s.order = gap_order(NULL, s.gaps, s.n);
+    MYMALLOC(s.rank, s.n);
+    MYMALLOC(s.apos, s.n);
+    MYMALLOC(s.wbeg, s.n / GAP_WIN_BOXES + 2);
+    if (s.rank == NULL || s.apos == NULL || s.wbeg == NULL)
+        mem_alloc_error("gap windows");
+    for (k = 0; k < s.n; k++) {
+        s.rank[s.order[k].y] = k;
+        s.apos[k] = (pair64_t) {(uint64) s.gaps[k].abpos ^ 1ULL<<63, k};
+    }
+    radix_sort_px(s.apos, s.apos + s.n);
+
+    // query windows of about GAP_WIN_BOXES boxes; boxes of the same start go to one window
+    for (k = nw = 0; k < s.n; ) {
+        s.wbeg[nw++] = k;
+        for (k = MIN(k + GAP_WIN_BOXES, s.n); k < s.n && s.apos[k].x == s.apos[k-1].x; k++);
+    }
+    s.wbeg[nw] = s.n;
+    kt_for(n_threads, split_filter, &s, nw);
+
+    nw = (s.n + GAP_WIN_BOXES - 1) / GAP_WIN_BOXES;
+    MYCALLOC(s.outs, nw);
+    if (s.outs == NULL)
+        mem_alloc_error("gap windows");
+    kt_for(n_threads, split_format, &s, nw);
+    for (j = 0; j < nw; j++) {
+        kputsn(s.outs[j].s.s, s.outs[j].s.l, &out->s);
+        for (k = 0; k < 4; k++)
+            out->stats[k] += s.outs[j].stats[k];
+        out->n_drop += s.outs[j].n_drop;
+        out->n_trim += s.outs[j].n_trim;
+        free(s.outs[j].s.s);
+    }
+
+    free(s.outs);
+    free(s.wbeg);
+    free(s.apos);
+    free(s.rank);
+    free(s.order);
+    free(s.gaps);
+    free(s.alns);
+}
+
+void gap_core(void *_b, long i, int tid)
+{
+    gap_batch_t *b = (gap_batch_t *) _b;
+    data_t *data = b->data;
+
+    // split groups are done afterwards, one at a time
+    if ((uint32) data->ranges[b->beg + i] >= GAP_SPLIT_SIZE)
+        return;
+    gap_group(data, b->beg + i, data->kms[tid], &b->outs[i]);
+    km_check(data, tid);
+}
+
+static void *gap_pipeline(void *shared, int step, void *in)
+{
+    // step 0: find the gaps of a batch of groups in parallel; step 1: write them out in order
+    data_t *data = (data_t *) shared;
+    gap_batch_t *b = (gap_batch_t *) in;
+    gap_out_t *out;
+    int64 i, n;
+
+    if (step == 0) {
+        if (data->next >= data->n_ranges)
+            return 0;
+        MYCALLOC(b, 1);
+        if (b == NULL)
+            mem_alloc_error("gap batch");
+        b->data = data;
+        b->beg = data->next;
+        for (i = b->beg, n = 0; i < data->n_ranges && n < GAP_BATCH_SIZE; i++)
+            n += (uint32) data->ranges[i];
+        b->end = data->next = i;
+        MYCALLOC(b->outs, b->end - b->beg);
+        if (b->outs == NULL)
+            mem_alloc_error("gap batch");
+        kt_for(data->n_threads, gap_core, b, b->end - b->beg);
+        for (i = b->beg; i < b->end; i++)
+            if ((uint32) data->ranges[i] >= GAP_SPLIT_SIZE)
+                gap_group_split(data, i, &b->outs[i - b->beg]);
+        return b;
+    } else if (step == 1) {
+        for (i = 0; i < b->end - b->beg; i++) {
+            out = &b->outs[i];
+            if (out->s.l > 0 && data->budget)
+                kputsn(out->s.s, out->s.l, &data->picks);
+            else if (out->s.l > 0)
+                fwrite(out->s.s, 1, out->s.l, data->fp);
+            data->stats[0] += out->stats[0];
+            data->stats[1] += out->stats[1];
+            data->stats[2] += out->stats[2];
+            data->stats[3] += out->stats[3];
+            data->n_drop += out->n_drop;
+            data->n_trim += out->n_trim;
+            free(out->s.s);
+        }
+        free(b->outs);
+        free(b);
+    }
+    return 0;
+}
+
+#define GAP_HEADER "#Q_NAME\tQ_BEG\tQ_END\tT_NAME\tT_BEG\tT_END\tQ_BEG_OVL\tQ_END_OVL\tT_BEG_OVL\tT_END_OVL\n"
+
+static void gap_header(FILE *fp, sdict_t *qdicts, sdict_t *tdicts, int binary)
+{
+    // the binary header carries the name tables, so that records refer to sequences by index
+    gapbin_hdr_t h;
+    sdict_t *d;
+    int64 l;
+    uint32 i;
+    int k;
+    static const char pad[8] = {0};
+
+    if (!binary) {
+        fputs(GAP_HEADER, fp);
+        return;
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, GAPBIN_MAGIC, 8);
+    for (k = 0; k < 2; k++) {
+        d = k == 0? qdicts : tdicts;
+        h.n_seq[k] = d->n;
+        h.sum[k] = GAPBIN_SUM0;
+        for (i = 0; i < d->n; i++) {
+            h.sum[k] = gapbin_sum(h.sum[k], d->s[i].name, d->s[i].len);
+            h.l_names += sizeof(uint32) + strlen(d->s[i].name) + 1;
+        }
+    }
+    l = h.l_names;
+    h.l_names = (h.l_names + 7) & ~7ULL;
+    fwrite(&h, sizeof(h), 1, fp);
+    for (k = 0; k < 2; k++) {
+        d = k == 0? qdicts : tdicts;
+        for (i = 0; i < d->n; i++) {
+            fwrite(&d->s[i].len, sizeof(uint32), 1, fp);
+            fwrite(d->s[i].name, 1, strlen(d->s[i].name) + 1, fp);
+        }
+    }
+    fwrite(pad, 1, h.l_names - l, fp);
+}
+
+static int VORDER(const void *a, const void *b)
+{
+    // by value descending, then in group order
+    const gap_pick_t *x = (const gap_pick_t *) a, *y = (const gap_pick_t *) b;
+    if (x->value != y->value) return x->value < y->value? 1 : -1;
+    return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+static void gap_select(data_t *data)
+{
+    // greedy by value: a box that does not fit in what is left of the budget is passed over for the next ones
+    // the boxes kept are written in decreasing value, and the stats are theirs
+    gap_pick_t *picks = (gap_pick_t *) data->picks.s;
+    int64 i, k, n = data->picks.l / sizeof(gap_pick_t);
+    double used, yield;
+    gapbin_rec_t *r;
+
+    for (i = 0; i < n; i++)
+        picks[i].idx = i;
+    qsort(picks, n, sizeof(gap_pick_t), VORDER);
+    memset(data->stats, 0, sizeof(data->stats));
+    used = yield = 0;
+    for (i = k = 0; i < n; i++) {
+        if (used + picks[i].cost > data->budget->max_cost)
+            continue;
+        used += picks[i].cost;
+        yield += picks[i].yield;
+        r = &picks[i].r;
+        data->stats[0] += 1;
+        data->stats[1] += r->qend - r->qbeg;
+        data->stats[2] += r->tend - r->tbeg;
+        data->stats[3] += (r->qend - r->qbeg) * (r->tend - r->tbeg);
+        if (data->binary)
+            fwrite(r, sizeof(gapbin_rec_t), 1, data->fp);
+        else
+            fprintf(data->fp, GAP_FMT, data->qdicts->s[r->qid].name, r->qbeg, r->qend, data->tdicts->s[r->tid].name,
+                r->tbeg, r->tend, r->qbol, r->qeol, r->tbol, r->teol);
+        k++;
+    }
+    fprintf(stderr, "[M::%s] %lld of %lld boxes within the budget: %.0f of %.0f cells; expected yield %.0f bases\n",
+        __func__, k, n, used, data->budget->max_cost, yield);
+}
+
+static int align_gaps(alns_t *alns, sdict_t *qdicts, sdict_t *tdicts, int n_threads, int min_gap, int max_gap, int max_ovl,
+    int binary, const gap_budget_t *budget, const gap_cover_t *cover, FILE *fp, int64 *stats)
+{
+    // the gaps are written without the header; stats are the number, q/t bases and area of the boxes 
+    int64 naln = alns->n;
     if (naln <= 0) return 0;
 
-    int64 i, j, m;
-    int a, b;
+    int64 i, j;
+    uint32 a, b, *aread, *bread;
     kvec_t(uint64) ranges;
-    aln_v  *abufs;
-    gap_v  *gbufs;
+    void  **kms;
     data_t *data;
 
-    qsort(alns, naln, sizeof(aln_t), RORDER);
+    alns_group_sort(alns, n_threads);
 
     kv_init(ranges);
-    a = alns->aread;
-    b = alns->bread;
-    m = 0;
+    aread = alns->c[A_READ];
+    bread = alns->c[B_READ];
+    a = aread[0];
+    b = bread[0];
     for (i = 1, j = 0; i < naln; i++) {
-        if (alns[i].aread != a || alns[i].bread != b) {
+        if (aread[i] != a || bread[i] != b) {
             kv_push(uint64, ranges, (uint64)j<<32|(i-j));
-            if (m < i-j) m = i-j;
             j = i;
-            a = alns[j].aread;
-            b = alns[j].bread;
+            a = aread[j];
+            b = bread[j];
         }
     }
     kv_push(uint64, ranges, (uint64)j<<32|(i-j));
-    if (m < i-j) m = i-j;
-    MYCALLOC(abufs, n_threads);
-    MYCALLOC(gbufs, n_threads);
-    if (abufs == NULL || gbufs == NULL)
-        mem_alloc_error("a/g bufs");
-    for (i = 0; i < n_threads; i++) {
-        kv_resize(aln_t, abufs[i], m+2);
-        kv_resize(gap_t, gbufs[i], m*4);
-        if (abufs[i].a == NULL || gbufs[i].a == NULL)
-            mem_alloc_error("a/g bufs");
-    }
+    MYCALLOC(kms, n_threads);
+    if (kms == NULL)
+        mem_alloc_error("thread arenas");
+    for (i = 0; i < n_threads; i++)
+        kms[i] = km_init();
 
     MYCALLOC(data, 1);
     data->min_gap = min_gap;
     data->max_gap = max_gap;
     data->max_ovl = max_ovl;
+    data->n_threads = n_threads;
+    data->binary = binary;
+    data->budget = budget;
+    data->cover = cover;
+    data->fp = fp;
     data->alns  = alns;
-    data->abufs = abufs;
-    data->gbufs = gbufs;
+    data->kms   = kms;
     data->ranges = ranges.a;
+    data->n_ranges = ranges.n;
     data->tdicts = tdicts;
     data->qdicts = qdicts;
 
-    // print header
-    fprintf(stdout, "#Q_NAME\tQ_BEG\tQ_END\tT_NAME\tT_BEG\tT_END\tQ_BEG_OVL\tQ_END_OVL\tT_BEG_OVL\tT_END_OVL\n");
-    
-    kt_for(n_threads, gap_core, data, ranges.n);
+    kt_pipeline(2, gap_pipeline, data, 2);
+    if (cover)
+        fprintf(stderr, "[M::%s] %lld boxes dropped and %lld trimmed as covered by the input alignments\n", __func__, data->n_drop, data->n_trim);
+    if (budget)
+        gap_select(data);
+    free(data->picks.s);
 
-    for (i = 0; i < n_threads; i++) {
-        kv_destroy(abufs[i]);
-        kv_destroy(gbufs[i]);
-    }
-    free(abufs);
-    free(gbufs);
-    free(data);
+    for (i = 0; i < n_threads; i++)
+        km_destroy(kms[i]);
+    free(kms);
     kv_destroy(ranges);
 
-    fprintf(stderr, "[M::%s]: selected gap filling boxes: %lld; q_bases: %lld; t_bases: %lld; area: %lld\n", __func__, b_stats[0], b_stats[1], b_stats[2], b_stats[3]);
+    for (i = 0; i < 4; i++)
+        stats[i] += data->stats[i];
+    free(data);
 
     return 0;
 }
 
+static void stream_flush(stream_t *st, alns_t *alns)
+{
+    // the alignments of one query are complete: select the reciprocal best ones in mlen order,
+    // against the target coverage of the queries done before, then write the gaps
+    uint32 qid = alns->c[A_READ][0], *order;
+    uint64 *perm;
+    int64 i, n = alns->n, ns, nb, n_sel = 0, beg[2] = {0, n};
+    rba_t d;
+
+    st->n_rec += n;
+    if (st->do_rba) {
+        if (st->m_q < st->qdicts->n || st->m_t < st->tdicts->n) {
+            MYREALLOC(st->q_span, st->qdicts->n);
+            MYREALLOC(st->t_span, st->tdicts->n);
+            if (st->q_span == NULL || st->t_span == NULL)
+                mem_alloc_error("q&t spans");
+            memset(st->q_span + st->m_q, 0, sizeof(rangeset_t) * (st->qdicts->n - st->m_q));
+            memset(st->t_span + st->m_t, 0, sizeof(rangeset_t) * (st->tdicts->n - st->m_t));
+            st->m_q = st->qdicts->n;
+            st->m_t = st->tdicts->n;
+        }
+        MYMALLOC(perm, n);
+        if (perm == NULL)
+            mem_alloc_error("alignment order");
+        for (i = 0; i < n; i++)
+            perm[i] = (uint64) (~alns->c[M_LEN][i]) << 32 | i;
+        radix_sort_par_u64(perm, n, st->n_threads);
+        order = (uint32 *) perm;
+        for (i = 0; i < n; i++)
+            order[i] = (uint32) perm[i];
+        d.alns = alns;
+        d.order = order;
+        d.beg = beg;
+        d.n_sel = &n_sel;
+        d.q_span = st->q_span;
+        d.t_span = st->t_span;
+        d.max_cov = st->max_cov;
+        rba_component(&d, 0, 0);
+        st->n_sel += n_sel;
+        free(perm);
+        rangeset_stats(&st->q_span[qid], &ns, &nb);
+        st->q_ns += ns;
+        st->q_nb += nb;
+        rangeset_destroy(&st->q_span[qid]);
+        alns_compact(alns);
+    }
+    align_gaps(alns, st->qdicts, st->tdicts, st->n_threads, st->min_gap, st->max_gap, st->max_ovl, 0, NULL, NULL, stdout, st->stats);
+    if (fflush(stdout) == EOF) {
+        fprintf(stderr, "[E::%s] failed to write the results\n", __func__);
+        exit(EXIT_FAILURE);
+    }
+    while (st->done.n <= qid)
+        kv_push(uint8, st->done, 0);
+    st->done.a[qid] = 1;
+    alns->n = 0;
+}
+
+static void stream_next(stream_t *st, alns_t *alns, uint32 qid)
+{
+    // a new query begins, so the last one is complete; a query seen before means unsorted input
+    if (alns->n > 0)
+        stream_flush(st, alns);
+    if (qid < st->done.n && st->done.a[qid]) {
+        fprintf(stderr, "[E::%s] input not sorted by query: records of %s are not adjacent\n", __func__, st->qdicts->s[qid].name);
+        exit(1);
+    }
+}
+
 static inline int64 parse_num2(const char *str, char **q)
 {
 	double x;
@@ -508,10 +1820,461 @@ static inline int64 parse_num(const char *str)
 	return parse_num2(str, 0);
 }
 
+static void xruns_put(xruns_t *r, FILE *fp, int lv)
+{
+    if (r->n == r->m) {
+        r->m = r->m? r->m << 1 : 16;
+        MYREALLOC(r->fp, r->m);
+        MYREALLOC(r->lv, r->m);
+        if (r->fp == NULL || r->lv == NULL)
+            mem_alloc_error("spill runs");
+    }
+    r->lv[r->n] = lv;
+    r->fp[r->n++] = fp;
+}
+
+static void xruns_destroy(xruns_t *r)
+{
+    int i;
+    for (i = 0; i < r->n; i++)
+        fclose(r->fp[i]);
+    free(r->fp);
+    free(r->lv);
+    memset(r, 0, sizeof(xruns_t));
+}
+
+static FILE *ext_tmpfile(const char *dir)
+{
+    // an unlinked file, removed as soon as it is closed
+    char *template;
+    FILE *fp;
+    int fd;
+    MYMALLOC(template, strlen(dir) + 16);
+    if (template == NULL)
+        mem_alloc_error("temporary file");
+    sprintf(template, "%s/alngapXXXXXX", dir);
+    fd = mkstemp(template);
+    if (fd == -1) {
+        fprintf(stderr, "[E::%s] failed to make temporary file: %s: %s\n", __func__, template, strerror(errno));
+        exit (1);
+    }
+    if (unlink(template) == -1) {
+        fprintf(stderr, "[E::%s] failed to remove temporary file %s\n", __func__, template);
+        exit (1);
+    }
+    fp = fdopen(fd, "w+b");
+    if (fp == NULL) {
+        fprintf(stderr, "[E::%s] failed to open file to write: %s\n", __func__, template);
+        exit (1);
+    }
+    setvbuf(fp, NULL, _IOFBF, 0x10000);
+    free(template);
+    return fp;
+}
+
+// k-way merge of runs; heap[0] is the next record
+typedef struct {
+    xrec_t r;
+    int run;
+} xhead_t;
+
+typedef struct {
+    xruns_t *runs;
+    int by_mlen, n;
+    xhead_t *heap;
+} xmerge_t;
+
+static inline int xrec_lt(const xrec_t *a, const xrec_t *b, int by_mlen)
+{
+    if (by_mlen)
+        return a->mlen != b->mlen? a->mlen > b->mlen : a->idx < b->idx;
+    if (a->aread != b->aread) return a->aread < b->aread;
+    if (a->bread != b->bread) return a->bread < b->bread;
+    if (a->abpos != b->abpos) return a->abpos < b->abpos;
+    if (a->bbpos != b->bbpos) return a->bbpos < b->bbpos;
+    if (a->aepos != b->aepos) return a->aepos < b->aepos;
+    return a->bepos < b->bepos;
+}
+
+static void xmerge_down(xmerge_t *m, int i)
+{
+    xhead_t *h = m->heap, t = h[i];
+    int k;
+    while ((k = 2 * i + 1) < m->n) {
+        if (k + 1 < m->n && xrec_lt(&h[k+1].r, &h[k].r, m->by_mlen)) ++k;
+        if (!xrec_lt(&h[k].r, &t.r, m->by_mlen)) break;
+        h[i] = h[k];
+        i = k;
+    }
+    h[i] = t;
+}
+
+static void xmerge_init(xmerge_t *m, xruns_t *runs, int by_mlen)
+{
+    int i;
+    m->runs = runs;
+    m->by_mlen = by_mlen;
+    m->n = 0;
+    MYMALLOC(m->heap, MAX(runs->n, 1));
+    if (m->heap == NULL)
+        mem_alloc_error("run merge");
+    for (i = 0; i < runs->n; i++) {
+        if (fread(&m->heap[m->n].r, sizeof(xrec_t), 1, runs->fp[i]) == 1)
+            m->heap[m->n++].run = i;
+    }
+    for (i = m->n / 2 - 1; i >= 0; i--)
+        xmerge_down(m, i);
+}
+
+static int xmerge_next(xmerge_t *m, xrec_t *r)
+{
+    FILE *fp;
+    if (m->n == 0) return 0;
+    *r = m->heap[0].r;
+    fp = m->runs->fp[m->heap[0].run];
+    if (fread(&m->heap[0].r, sizeof(xrec_t), 1, fp) != 1) {
+        if (ferror(fp)) {
+            fprintf(stderr, "[E::%s] failed to read temporary file\n", __func__);
+            exit (1);
+        }
+        m->heap[0] = m->heap[--m->n];
+    }
+    if (m->n > 0) xmerge_down(m, 0);
+    return 1;
+}
+
+// the number of runs merged into one while spilling
+#define EXT_FAN_IN 64
+
+static void xrec_write(const xrec_t *r, FILE *fp, const char *dir)
+{
+    if (fwrite(r, sizeof(xrec_t), 1, fp) != 1) {
+        fprintf(stderr, "[E::%s] failed to write temporary file in %s: %s\n", __func__, dir, strerror(errno));
+        exit (1);
+    }
+}
+
+static FILE *xrun_close(FILE *fp, const char *dir)
+{
+    // done writing: rewind for the merge
+    if (fflush(fp) == EOF) {
+        fprintf(stderr, "[E::%s] failed to write temporary file in %s: %s\n", __func__, dir, strerror(errno));
+        exit (1);
+    }
+    rewind(fp);
+    return fp;
+}
+
+static void xruns_fold(xruns_t *runs, int by_mlen, const char *dir)
+{
+    // the last EXT_FAN_IN runs of one level are merged into a run of the next level, as the
+    // digits of a counter, so that few files are open and records are rewritten a few times
+    xruns_t tail;
+    xmerge_t m;
+    xrec_t r;
+    FILE *fp;
+    int i, lv;
+    while (runs->n >= EXT_FAN_IN && runs->lv[runs->n - EXT_FAN_IN] == runs->lv[runs->n - 1]) {
+        memset(&tail, 0, sizeof(xruns_t));
+        tail.n = EXT_FAN_IN;
+        tail.fp = runs->fp + runs->n - EXT_FAN_IN;
+        fp = ext_tmpfile(dir);
+        xmerge_init(&m, &tail, by_mlen);
+        while (xmerge_next(&m, &r))
+            xrec_write(&r, fp, dir);
+        free(m.heap);
+        for (i = 0; i < tail.n; i++)
+            fclose(tail.fp[i]);
+        lv = runs->lv[runs->n - 1] + 1;
+        runs->n -= EXT_FAN_IN;
+        xruns_put(runs, xrun_close(fp, dir), lv);
+    }
+}
+
+static void ext_write(ext_t *ext, xruns_t *runs, alns_t *alns, const uint32 *order)
+{
+    // write alns in order as a new run
+    FILE *fp;
+    xrec_t r;
+    int64 i;
+    uint32 j;
+    fp = ext_tmpfile(ext->dir);
+    for (i = 0; i < alns->n; i++) {
+        j = order? order[i] : i;
+        r = (xrec_t) {alns->c[A_READ][j], alns->c[B_READ][j], alns->c[A_BPOS][j], alns->c[A_EPOS][j],
+            alns->c[B_BPOS][j], alns->c[B_EPOS][j], alns->c[M_LEN][j], (uint32) (ext->n_in + j)};
+        xrec_write(&r, fp, ext->dir);
+    }
+    xruns_put(runs, xrun_close(fp, ext->dir), 0);
+    xruns_fold(runs, runs == &ext->mruns, ext->dir);
+}
+
+static void ext_spill(ext_t *ext, alns_t *alns)
+{
+    // alignments read are spilled in mlen order for the reciprocal best selection, or in
+    // group order straight for the gaps with -a; indices in the input break mlen ties
+    uint64 *perm;
+    uint32 *order;
+    int64 i;
+
+    if (alns->n == 0) return;
+    if (ext->do_rba) {
+        if (ext->n_in + alns->n > UINT32_MAX) {
+            fprintf(stderr, "[E::%s] too many alignments\n", __func__);
+            exit (1);
+        }
+        MYMALLOC(perm, alns->n);
+        if (perm == NULL)
+            mem_alloc_error("alignment order");
+        for (i = 0; i < alns->n; i++)
+            perm[i] = (uint64) (~alns->c[M_LEN][i]) << 32 | i;
+        radix_sort_par_u64(perm, alns->n, ext->n_threads);
+        order = (uint32 *) perm;
+        for (i = 0; i < alns->n; i++)
+            order[i] = (uint32) perm[i];
+        ext_write(ext, &ext->mruns, alns, order);
+        free(perm);
+    } else {
+        alns_group_sort(alns, ext->n_threads);
+        ext_write(ext, &ext->gruns, alns, NULL);
+    }
+    ext->n_in += alns->n;
+    alns->n = 0;
+}
+
+static int ext_align_gaps(ext_t *ext, alns_t *alns, sdict_t *qdicts, sdict_t *tdicts, double max_cov,
+    int min_gap, int max_gap, int max_ovl, int64 *stats)
+{
+    // the reciprocal best selection takes the merged mlen runs in the global mlen order, as the
+    // components would, and only keeps the coverage; the selected alignments are spilled in group
+    // order, merged and handed to align_gaps() by batches of whole groups
+    rangeset_t *q_span, *t_span;
+    xmerge_t m;
+    xrec_t r;
+    uint32 a, b;
+    int64 i, n_rec, ns, nb;
+    int ret = 0;
+
+    ext_spill(ext, alns);
+    fprintf(stderr, "[M::%s] %d runs of %lld records spilled to %s\n", __func__, ext->do_rba? ext->mruns.n : ext->gruns.n, ext->n_in, ext->dir);
+    if (ext->do_rba) {
+        MYCALLOC(q_span, qdicts->n + tdicts->n);
+        if (q_span == NULL)
+            mem_alloc_error("q&t spans");
+        t_span = q_span + qdicts->n;
+        xmerge_init(&m, &ext->mruns, 1);
+        n_rec = 0;
+        while (xmerge_next(&m, &r)) {
+            if (rangeset_cover(q_span + r.aread, r.abpos, r.aepos) > r.mlen * max_cov ||
+                    rangeset_cover(t_span + r.bread, r.bbpos, r.bepos) > r.mlen * max_cov)
+                continue;
+            rangeset_add(q_span + r.aread, r.abpos, r.aepos);
+            rangeset_add(t_span + r.bread, r.bbpos, r.bepos);
+            alns_push(alns, r.aread, r.bread, r.abpos, r.aepos, r.bbpos, r.bepos, r.mlen);
+            ++n_rec;
+            if (alns->n == ext->cap) {
+                alns_group_sort(alns, ext->n_threads);
+                ext_write(ext, &ext->gruns, alns, NULL);
+                alns->n = 0;
+            }
+        }
+        free(m.heap);
+        xruns_destroy(&ext->mruns);
+        fprintf(stderr, "[M::%s] processed %lld records, %lld selected\n", __func__, ext->n_in, n_rec);
+        coverage_summary(q_span, qdicts->n, &ns, &nb);
+        fprintf(stderr, "[M::%s] query genome covered with %lld segments of %lld bases\n", __func__, ns, nb);
+        coverage_summary(t_span, tdicts->n, &ns, &nb);
+        fprintf(stderr, "[M::%s] target genome covered with %lld segments of %lld bases\n", __func__, ns, nb);
+        for (i = qdicts->n + tdicts->n - 1; i >= 0; i--)
+            rangeset_destroy(&q_span[i]);
+        free(q_span);
+        if (ext->gruns.n == 0)
+            // the selection fits in memory
+            return align_gaps(alns, qdicts, tdicts, ext->n_threads, min_gap, max_gap, max_ovl, ext->binary, NULL, NULL, stdout, stats);
+        alns_group_sort(alns, ext->n_threads);
+        ext_write(ext, &ext->gruns, alns, NULL);
+        alns->n = 0;
+    }
+
+    xmerge_init(&m, &ext->gruns, 0);
+    a = b = UINT32_MAX;
+    while (xmerge_next(&m, &r)) {
+        if ((r.aread != a || r.bread != b) && alns->n >= ext->cap) {
+            ret |= align_gaps(alns, qdicts, tdicts, ext->n_threads, min_gap, max_gap, max_ovl, ext->binary, NULL, NULL, stdout, stats);
+            alns->n = 0;
+        }
+        a = r.aread;
+        b = r.bread;
+        alns_push(alns, r.aread, r.bread, r.abpos, r.aepos, r.bbpos, r.bepos, r.mlen);
+    }
+    ret |= align_gaps(alns, qdicts, tdicts, ext->n_threads, min_gap, max_gap, max_ovl, ext->binary, NULL, NULL, stdout, stats);
+    free(m.heap);
+    xruns_destroy(&ext->gruns);
+    return ret;
+}
+
+static void cover_init(gap_cover_t *cv, alns_t *alns, sdict_t *qdicts, sdict_t *tdicts, double max_frac)
+{
+    // all the alignments count, including those the reciprocal best selection drops
+    int64 i, ns, nb;
+    cv->max_frac = max_frac;
+    cv->n_q = qdicts->n;
+    cv->n_t = tdicts->n;
+    MYCALLOC(cv->q_cov, MAX(cv->n_q, 1));
+    MYCALLOC(cv->t_cov, MAX(cv->n_t, 1));
+    if (cv->q_cov == NULL || cv->t_cov == NULL)
+        mem_alloc_error("coverage");
+    for (i = 0; i < alns->n; i++) {
+        rangeset_add(cv->q_cov + alns->c[A_READ][i], alns->c[A_BPOS][i], alns->c[A_EPOS][i]);
+        rangeset_add(cv->t_cov + alns->c[B_READ][i], alns->c[B_BPOS][i], alns->c[B_EPOS][i]);
+    }
+    coverage_summary(cv->q_cov, cv->n_q, &ns, &nb);
+    fprintf(stderr, "[M::%s] query genome covered by the input with %lld segments of %lld bases\n", __func__, ns, nb);
+    coverage_summary(cv->t_cov, cv->n_t, &ns, &nb);
+    fprintf(stderr, "[M::%s] target genome covered by the input with %lld segments of %lld bases\n", __func__, ns, nb);
+}
+
+static void cover_destroy(gap_cover_t *cv)
+{
+    uint32 i;
+    for (i = 0; i < cv->n_q; i++)
+        rangeset_destroy(&cv->q_cov[i]);
+    for (i = 0; i < cv->n_t; i++)
+        rangeset_destroy(&cv->t_cov[i]);
+    free(cv->q_cov);
+    free(cv->t_cov);
+}
+
+// --sweep: parameter sets whose gaps are found from the same alignments
+typedef struct {
+    int min_gap, max_gap, max_ovl;
+    double max_cov;
+} gap_par_t;
+
+static int sweep_parse(const char *str, gap_par_t *par)
+{
+    // comma separated KEY=VAL with KEY among l, m, e and f; the others keep the command line values
+    const char *p = str;
+    char *q;
+    int64 v;
+    while (*p) {
+        if ((*p != 'l' && *p != 'm' && *p != 'e' && *p != 'f') || p[1] != '=')
+            return -1;
+        if (*p == 'f') {
+            par->max_cov = strtod(p + 2, &q);
+        } else {
+            v = parse_num2(p + 2, &q);
+            if (v < 0 || v > INT32_MAX) return -1;
+            if (*p == 'l') par->min_gap = v;
+            else if (*p == 'm') par->max_gap = v;
+            else par->max_ovl = v;
+        }
+        if (q == p + 2 || (*q && *q != ','))
+            return -1;
+        p = *q? q + 1 : q;
+    }
+    return 0;
+}
+
+static int sweep_gaps(alns_t *alns, sdict_t *qdicts, sdict_t *tdicts, gap_par_t *pars, int n_pars,
+    int do_rba, int binary, const gap_budget_t *budget, const gap_cover_t *cover, int n_threads, const char *prefix)
+{
+    // sets with the same -f share one selection of reciprocal best alignments, made on a copy of the
+    // input but for the last selection; the group order sorted for the first set is kept for the others
+    // the gaps of set i are written to PREFIX.i.txt, or PREFIX.i.bin with --binary
+    int64 stats[4];
+    int i, j, n_left, ret;
+    uint8 *done;
+    alns_t *sel;
+    FILE *fp;
+    kstring_t fn = {0, 0, 0};
+
+    MYCALLOC(done, n_pars);
+    if (done == NULL)
+        mem_alloc_error("parameter sets");
+    ret = 0;
+    n_left = n_pars;
+    for (i = 0; i < n_pars; i++) {
+        if (done[i]) continue;
+        for (j = i; j < n_pars; j++)
+            if (!done[j] && (!do_rba || pars[j].max_cov == pars[i].max_cov))
+                n_left--;
+        sel = n_left > 0? alns_copy(alns) : alns;
+        if (do_rba && sel->n > 0) {
+            fprintf(stderr, "[M::%s] reciprocal best alignments with -f %g\n", __func__, pars[i].max_cov);
+            reciprocal_best_aligns(sel, qdicts, tdicts, pars[i].max_cov, n_threads);
+        }
+        for (j = i; j < n_pars; j++) {
+            if (done[j] || (do_rba && pars[j].max_cov != pars[i].max_cov))
+                continue;
+            done[j] = 1;
+            fn.l = 0;
+            ksprintf(&fn, "%s.%d.%s", prefix, j + 1, binary? "bin" : "txt");
+            fp = fopen(fn.s, "wb");
+            if (fp == NULL) {
+                fprintf(stderr, "[E::%s] failed to write the output to file '%s': %s\n", __func__, fn.s, strerror(errno));
+                exit (1);
+            }
+            gap_header(fp, qdicts, tdicts, binary);
+            memset(stats, 0, sizeof(stats));
+            ret |= align_gaps(sel, qdicts, tdicts, n_threads, pars[j].min_gap, pars[j].max_gap, pars[j].max_ovl, binary, budget, cover, fp, stats);
+            if (fclose(fp) == EOF) {
+                fprintf(stderr, "[E::%s] failed to write the results to file '%s'\n", __func__, fn.s);
+                exit (1);
+            }
+            fprintf(stderr, "[M::%s] set %d (-l %d -m %d -e %d -f %g) to %s: boxes: %lld; q_bases: %lld; t_bases: %lld; area: %lld\n",
+                __func__, j + 1, pars[j].min_gap, pars[j].max_gap, pars[j].max_ovl, pars[j].max_cov, fn.s, stats[0], stats[1], stats[2], stats[3]);
+        }
+        if (sel != alns)
+            alns_destroy(sel);
+    }
+    free(done);
+    free(fn.s);
+    return ret;
+}
+
+static sdict_t *read_name_list(const char *fn)
+{
+    // one sequence name per line; anything after the first whitespace is ignored
+    paf_file_t *fp;
+    sdict_t *d;
+    char *line, *p;
+
+    fp = paf_open(fn);
+    if (!fp) {
+        fprintf(stderr, "[E::%s] failed to open file %s to read\n", __func__, fn);
+        exit (1);
+    }
+    d = sd_init();
+    while ((line = paf_read_line(fp)) != NULL) {
+        for (p = line; *p && !isspace((unsigned char) *p); p++) {}
+        *p = '\0';
+        if (*line && *line != '#')
+            sd_put(d, line, 0);
+    }
+    paf_close(fp);
+    fprintf(stderr, "[M::%s] read %u sequence names from %s\n", __func__, d->n, fn);
+    return d;
+}
+
 static ko_longopt_t long_options[] = {
     { "verbose",        ko_required_argument, 'v' },
     { "version",        ko_no_argument,       'V' },
     { "help",           ko_no_argument,       'h' },
+    { "sorted",         ko_no_argument,       300 },
+    { "tmp",            ko_required_argument, 301 },
+    { "max-mem",        ko_required_argument, 302 },
+    { "binary",         ko_no_argument,       303 },
+    { "sweep",          ko_required_argument, 304 },
+    { "budget-area",    ko_required_argument, 305 },
+    { "budget-cpu-hours", ko_required_argument, 306 },
+    { "cell-rate",      ko_required_argument, 307 },
+    { "max-covered",    ko_required_argument, 308 },
+    { "min-blen",       ko_required_argument, 309 },
+    { "min-idy",        ko_required_argument, 310 },
+    { "min-mapq",       ko_required_argument, 311 },
+    { "include",        ko_required_argument, 312 },
+    { "exclude",        ko_required_argument, 313 },
     { 0, 0, 0 }
 };
 
@@ -523,10 +2286,21 @@ int main(int argc, char *argv[])
     int n_threads;
     FILE *fp_help;
     sdict_t *tdicts, *qdicts;
-    aln_t *alns;
-    int64 naln;
-    int min_gap, max_gap, max_ovl, do_rba;
+    alns_t *alns;
+    int min_gap, max_gap, max_ovl, do_rba, sorted, binary;
     double max_cov;
+    int64 stats[4] = {0, 0, 0, 0}, ns, nb, i, max_mem;
+    char *tmp_dir, *out_fn, *end;
+    stream_t st;
+    ext_t ext;
+    kvec_t(const char *) sweeps;
+    gap_par_t *pars;
+    double budget_area, budget_hours, cell_rate, x;
+    gap_budget_t budget1, *budget;
+    double max_covered;
+    gap_cover_t cover1, *cover;
+    paf_filter_t flt1, *flt;
+    const char *incl_fn, *excl_fn;
     
     sys_init();
 
@@ -536,23 +2310,58 @@ int main(int argc, char *argv[])
     max_ovl = 1000;
     max_cov = 0.5;
     do_rba = 1;
+    sorted = 0;
+    binary = 0;
+    max_mem = 0;
+    tmp_dir = "./";
+    out_fn = NULL;
+    kv_init(sweeps);
+    pars = NULL;
+    budget_area = budget_hours = 0;
+    cell_rate = 1e9;
+    budget = NULL;
+    max_covered = -1;
+    cover = NULL;
+    memset(&flt1, 0, sizeof(paf_filter_t));
+    flt = NULL;
+    incl_fn = excl_fn = NULL;
     n_threads = 1;
   
     while ((c = ketopt(&opt, argc, argv, 1, opt_str, long_options)) >=0) {
         if (c == 'l') min_gap = (int) parse_num(opt.arg);
         else if (c == 'm') max_gap = (int) parse_num(opt.arg);
-        else if (c == 'f') max_cov = (int) parse_num(opt.arg);
+        else if (c == 'f') max_cov = atof(opt.arg);
         else if (c == 'e') max_ovl = atoi(opt.arg);
         else if (c == 'a') do_rba = 0;
-        else if (c == 't') n_threads = atoi(opt.arg);
-        else if (c == 'o') {
-            if (strcmp(opt.arg, "-") != 0) {
-                if (freopen(opt.arg, "wb", stdout) == NULL) {
-                    fprintf(stderr, "[ERROR]\033[1;31m failed to write the output to file '%s'\033[0m: %s\n", opt.arg, strerror(errno));
-                    return 1;
-                }
+        else if (c == 300) sorted = 1;
+        else if (c == 303) binary = 1;
+        else if (c == 301) tmp_dir = opt.arg;
+        else if (c == 302) max_mem = parse_num(opt.arg);
+        else if (c == 304) kv_push(const char *, sweeps, opt.arg);
+        else if (c == 305 || c == 306) {
+            x = c == 305? (double) parse_num2(opt.arg, &end) : strtod(opt.arg, &end);
+            if (end == opt.arg || *end || !(x > 0)) {
+                fprintf(stderr, "[E::%s] --%s must be positive: %s\n", __func__, c == 305? "budget-area" : "budget-cpu-hours", opt.arg);
+                return 1;
             }
+            if (c == 305) budget_area = x;
+            else budget_hours = x;
         }
+        else if (c == 307) cell_rate = parse_num(opt.arg);
+        else if (c == 308) {
+            max_covered = strtod(opt.arg, &end);
+            if (end == opt.arg || *end || max_covered < 0 || max_covered > 1) {
+                fprintf(stderr, "[E::%s] --max-covered must be a fraction in [0, 1]: %s\n", __func__, opt.arg);
+                return 1;
+            }
+        }
+        else if (c == 309) flt1.min_blen = (uint32) parse_num(opt.arg), flt = &flt1;
+        else if (c == 310) flt1.min_idy = atof(opt.arg), flt = &flt1;
+        else if (c == 311) flt1.min_mapq = atoi(opt.arg), flt = &flt1;
+        else if (c == 312) incl_fn = opt.arg, flt = &flt1;
+        else if (c == 313) excl_fn = opt.arg, flt = &flt1;
+        else if (c == 't') n_threads = atoi(opt.arg);
+        else if (c == 'o') out_fn = opt.arg;
         else if (c == 'v') VERBOSE = atoi(opt.arg);
         else if (c == 'h') fp_help = stdout;
         else if (c == 'V') {
@@ -569,17 +2378,42 @@ int main(int argc, char *argv[])
         }
     }
 
+    // with --sweep, the output is a prefix
+    if (out_fn && sweeps.n == 0 && strcmp(out_fn, "-") != 0) {
+        if (freopen(out_fn, "wb", stdout) == NULL) {
+            fprintf(stderr, "[ERROR]\033[1;31m failed to write the output to file '%s'\033[0m: %s\n", out_fn, strerror(errno));
+            return 1;
+        }
+    }
+
     if (argc == opt.ind || fp_help == stdout) {
         fprintf(fp_help, "\n");
-        fprintf(fp_help, "Usage: alngap [options] input.paf[.gz]\n");
+        fprintf(fp_help, "Usage: alngap [options] input.paf[.gz]|input.1aln\n");
         fprintf(fp_help, "Options:\n");
         fprintf(fp_help, "  -l INT               min gap size to fill in [100]\n");
         fprintf(fp_help, "  -m INT               max gap size to fill in [1M]\n");
         fprintf(fp_help, "  -e INT               max flank sequence size [1K]\n");
         fprintf(fp_help, "  -a                   use all instead of reciprocal best alignments\n");
-        fprintf(fp_help, "  -f INT               max overlap for reciprocal best alignments [%.1f]\n", max_cov);
+        fprintf(fp_help, "  -f FLOAT             max overlap for reciprocal best alignments [%.1f]\n", max_cov);
         fprintf(fp_help, "  -t INT               number of threads [%d]\n", n_threads);
+        fprintf(fp_help, "  --sorted             input sorted by query; stream it one query at a time\n");
+        fprintf(fp_help, "  --max-mem NUM        memory for alignments, spilled to disk beyond it [no limit]\n");
+        fprintf(fp_help, "  --tmp DIR            directory for the files spilled with --max-mem [%s]\n", tmp_dir);
         fprintf(fp_help, "  -o FILE              write output to a file [stdout]\n");
+        fprintf(fp_help, "  --binary             write binary intervals for alnfill; not with --sorted\n");
+        fprintf(fp_help, "  --sweep STR          parameter set as l=INT,m=INT,e=INT,f=FLOAT; repeat for more sets,\n");
+        fprintf(fp_help, "                       each written to PREFIX.N.txt with -o PREFIX\n");
+        fprintf(fp_help, "  --budget-area NUM    keep the boxes of highest expected yield within this total area\n");
+        fprintf(fp_help, "  --budget-cpu-hours FLOAT\n");
+        fprintf(fp_help, "                       keep the boxes of highest expected yield within this CPU time\n");
+        fprintf(fp_help, "  --cell-rate NUM      DP cells filled per CPU second, for --budget-cpu-hours [1G]\n");
+        fprintf(fp_help, "  --max-covered FLOAT  drop gaps covered by input alignments beyond this fraction on either\n");
+        fprintf(fp_help, "                       sequence, and trim the covered ends of the others [off]\n");
+        fprintf(fp_help, "  --min-blen NUM       skip alignments with a shorter alignment block [0]\n");
+        fprintf(fp_help, "  --min-idy FLOAT      skip alignments with a lower identity (matches over block length) [0]\n");
+        fprintf(fp_help, "  --min-mapq INT       skip alignments with a lower mapping quality [0]\n");
+        fprintf(fp_help, "  --include FILE       skip alignments unless both sequence names are listed in FILE\n");
+        fprintf(fp_help, "  --exclude FILE       skip alignments if either sequence name is listed in FILE\n");
         fprintf(fp_help, "  -v INT               verbose level [%d]\n", VERBOSE);
         fprintf(fp_help, "  --version            show version number\n");
         fprintf(fp_help, "\n");
@@ -592,24 +2426,139 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (sorted && binary) {
+        fprintf(stderr, "[E::%s] --binary needs all the sequence names before the first interval; not supported with --sorted\n", __func__);
+        return 1;
+    }
+
+    if (budget_area > 0 || budget_hours > 0) {
+        if (sorted || max_mem > 0 || (budget_area > 0 && budget_hours > 0) || cell_rate <= 0) {
+            fprintf(stderr, "[E::%s] use one of --budget-area and --budget-cpu-hours, with a positive --cell-rate, and without --sorted or --max-mem\n", __func__);
+            return 1;
+        }
+        // the area is all the cost of a box, while CPU time also has the overhead of each alnfill interval
+        budget1.max_cost = budget_area > 0? budget_area : budget_hours * 3600 * cell_rate;
+        budget1.fixed = budget_area > 0? 0 : FILL_FIXED_COST;
+        budget = &budget1;
+    }
+
+    if (max_covered >= 0 && (sorted || max_mem > 0)) {
+        fprintf(stderr, "[E::%s] --max-covered needs all the alignments in memory; not supported with --sorted or --max-mem\n", __func__);
+        return 1;
+    }
+
+    if (sweeps.n > 0) {
+        if (out_fn == NULL || strcmp(out_fn, "-") == 0 || sorted || max_mem > 0) {
+            fprintf(stderr, "[E::%s] --sweep needs an output prefix with -o, and is not supported with --sorted or --max-mem\n", __func__);
+            return 1;
+        }
+        MYMALLOC(pars, sweeps.n);
+        if (pars == NULL)
+            mem_alloc_error("parameter sets");
+        for (i = 0; i < (int64) sweeps.n; i++) {
+            pars[i] = (gap_par_t) {min_gap, max_gap, max_ovl, max_cov};
+            if (sweep_parse(sweeps.a[i], &pars[i]) < 0) {
+                fprintf(stderr, "[E::%s] invalid parameter set: \"%s\"\n", __func__, sweeps.a[i]);
+                return 1;
+            }
+        }
+    }
+
+    if (flt1.min_mapq > 0) {
+        for (i = opt.ind; i < argc; i++)
+            if (onealn_is(argv[i]))
+                fprintf(stderr, "[W::%s] .1aln alignments have no mapping quality; --min-mapq does not apply to %s\n", __func__, argv[i]);
+    }
+
+    if (incl_fn)
+        flt1.incl = read_name_list(incl_fn);
+    if (excl_fn)
+        flt1.excl = read_name_list(excl_fn);
+
     // read PAF files
     qdicts = sd_init();
     tdicts = sd_init();
     
-    alns = read_pafs(argv + opt.ind, argc - opt.ind, qdicts, tdicts, &naln);
-    
-    if (naln == 0)
-        fprintf(stderr, "[W::%s] empty input PAF file\n", __func__);
-    else if (do_rba)
-        // find reciprocal best alignments
-        alns = reciprocal_best_aligns(alns, naln, qdicts, tdicts, max_cov, &naln);
-
-    // find gaps
-    ret = align_gaps(alns, naln, qdicts, tdicts, n_threads, min_gap, max_gap, max_ovl);
-    
+    if (pars) {
+        // parse once, then find the gaps of every parameter set
+        alns = read_pafs(argv + opt.ind, argc - opt.ind, qdicts, tdicts, n_threads, flt, NULL, NULL);
+        if (alns->n == 0)
+            fprintf(stderr, "[W::%s] empty input PAF file\n", __func__);
+        if (max_covered >= 0)
+            cover_init(cover = &cover1, alns, qdicts, tdicts, max_covered);
+        ret = sweep_gaps(alns, qdicts, tdicts, pars, sweeps.n, do_rba, binary, budget, cover, n_threads, out_fn);
+    } else if (sorted) {
+        // read, select and find gaps one query at a time
+        memset(&st, 0, sizeof(stream_t));
+        st.n_threads = n_threads;
+        st.do_rba = do_rba;
+        st.min_gap = min_gap;
+        st.max_gap = max_gap;
+        st.max_ovl = max_ovl;
+        st.max_cov = max_cov;
+        st.qdicts = qdicts;
+        st.tdicts = tdicts;
+        // queries are written as they are done, and the input may have none
+        gap_header(stdout, qdicts, tdicts, 0);
+        alns = read_pafs(argv + opt.ind, argc - opt.ind, qdicts, tdicts, n_threads, flt, &st, NULL);
+        if (st.n_rec == 0)
+            fprintf(stderr, "[W::%s] empty input PAF file\n", __func__);
+        else if (do_rba) {
+            fprintf(stderr, "[M::%s] processed %lld records, %lld selected\n", __func__, st.n_rec, st.n_sel);
+            fprintf(stderr, "[M::%s] query genome covered with %lld segments of %lld bases\n", __func__, st.q_ns, st.q_nb);
+            coverage_summary(st.t_span, st.m_t, &ns, &nb);
+            fprintf(stderr, "[M::%s] target genome covered with %lld segments of %lld bases\n", __func__, ns, nb);
+        }
+        for (i = 0; i < st.m_t; i++)
+            rangeset_destroy(&st.t_span[i]);
+        free(st.q_span);
+        free(st.t_span);
+        kv_destroy(st.done);
+        memcpy(stats, st.stats, sizeof(stats));
+    } else {
+        if (max_mem > 0) {
+            // alignments held in memory: 28 bytes for the columns, and up to 20 for sorting
+            memset(&ext, 0, sizeof(ext_t));
+            ext.dir = tmp_dir;
+            ext.cap = MAX(max_mem / 48, 1<<16);
+            ext.n_threads = n_threads;
+            ext.do_rba = do_rba;
+            ext.binary = binary;
+        }
+        alns = read_pafs(argv + opt.ind, argc - opt.ind, qdicts, tdicts, n_threads, flt, NULL, max_mem > 0? &ext : NULL);
+
+        if (max_mem > 0 && ext.n_in > 0) {
+            // some alignments were spilled to disk
+            gap_header(stdout, qdicts, tdicts, binary);
+            ret = ext_align_gaps(&ext, alns, qdicts, tdicts, max_cov, min_gap, max_gap, max_ovl, stats);
+        } else {
+            if (alns->n == 0)
+                fprintf(stderr, "[W::%s] empty input PAF file\n", __func__);
+            else {
+                if (max_covered >= 0)
+                    cover_init(cover = &cover1, alns, qdicts, tdicts, max_covered);
+                if (do_rba)
+                    // find reciprocal best alignments
+                    reciprocal_best_aligns(alns, qdicts, tdicts, max_cov, n_threads);
+            }
+            gap_header(stdout, qdicts, tdicts, binary);
+
+            // find gaps
+            ret = align_gaps(alns, qdicts, tdicts, n_threads, min_gap, max_gap, max_ovl, binary, budget, cover, stdout, stats);
+        }
+    }
+    if (pars == NULL)
+        fprintf(stderr, "[M::%s] selected gap filling boxes: %lld; q_bases: %lld; t_bases: %lld; area: %lld\n", __func__, stats[0], stats[1], stats[2], stats[3]);
+
     sd_destroy(qdicts);
     sd_destroy(tdicts);
-    free(alns);
+    alns_destroy(alns);
+    free(pars);
+    kv_destroy(sweeps);
+    if (cover)
+        cover_destroy(cover);
+    sd_destroy(flt1.incl);
+    sd_destroy(flt1.excl);
 
     if (ret) {
         fprintf(stderr, "[E::%s] failed to analysis the PAF file\n", __func__);
@@ -0,0 +1,71 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#ifndef GAPBIN_H_
+#define GAPBIN_H_
+
+#include "misc.h"
+
+// binary interval file written by "alngap --binary" and mapped by alnfill
+// header | name table | records; values are in host byte order
+// the name table has, for each query then each target sequence, the 32-bit length followed by
+// the NULL terminated name, and is zero padded to a multiple of 8 bytes
+// the number of records follows from the file size
+
+#define GAPBIN_MAGIC "ALNGAPB\1"
+#define GAPBIN_SUM0  0xcbf29ce484222325ULL
+
+typedef struct {
+    char   magic[8];
+    uint64 n_seq[2]; // query and target sequences
+    uint64 sum[2];   // checksums of the query and target names and lengths
+    uint64 l_names;  // bytes of the name table, padding included
+} gapbin_hdr_t;
+
+typedef struct {
+    uint32 qid, tid; // indices in the name table
+    int64  qbeg, qend;
+    int64  tbeg, tend;
+    int32  qbol, qeol;
+    int32  tbol, teol;
+} gapbin_rec_t;
+
+static inline uint64 gapbin_sum(uint64 h, const char *name, uint32 len)
+{
+    // FNV-1a over the name, its terminator and the length; start from GAPBIN_SUM0
+    int i;
+    do {
+        h = (h ^ (uint8) *name) * 0x100000001b3ULL;
+    } while (*name++);
+    for (i = 0; i < 4; i++, len >>= 8)
+        h = (h ^ (len & 0xff)) * 0x100000001b3ULL;
+    return h;
+}
+
+#endif /* GAPBIN_H_ */
@@ -49,6 +49,10 @@ typedef double             float64;
 
 #define BUFF_SIZE 4096
 
+// fixed per-interval overhead of alnfill (process spawn, seed table, file I/O) in units of DP
+// cells; used by the alnfill shard balancer and the alngap CPU budget
+#define FILL_FIXED_COST 0x100000
+
 #ifndef kroundup32
 #define kroundup32(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 #endif
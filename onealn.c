@@ -0,0 +1,278 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "misc.h"
+#include "onealn.h"
+
+int onealn_is(const char *fn)
+{
+    size_t l = fn? strlen(fn) : 0;
+    return l > 5 && strcmp(fn + l - 5, ".1aln") == 0;
+}
+
+#ifdef HAVE_ONELIB
+
+#include "ONElib.h"
+
+// the scaffolds of a .1gdb and the position of each contig in them
+typedef struct {
+    int64 n_ctg, n_scf;
+    uint32 *scf;   // scaffold of each contig
+    uint32 *beg;   // offset of each contig in its scaffold
+    uint32 *len;   // length of each contig
+    uint32 *slen;  // length of each scaffold
+    char **names;  // scaffold names up to the first space
+} onegdb_t;
+
+struct onealn_file_s {
+    OneFile *of;
+    onegdb_t *gdb[2];
+    int64 n; // alignments read
+    char t;  // type of the line read ahead; 'A' if an alignment is pending
+};
+
+static void onegdb_destroy(onegdb_t *g)
+{
+    int64 i;
+    if (g == NULL) return;
+    for (i = 0; i < g->n_scf; i++)
+        free(g->names[i]);
+    free(g->names);
+    free(g->slen);
+    free(g->scf);
+    free(g->beg);
+    free(g->len);
+    free(g);
+}
+
+static onegdb_t *onegdb_read(const char *fn)
+{
+    // scaffolds are 'S' lines followed by their 'G' gaps and 'C' contigs in order
+    OneFile *of;
+    onegdb_t *g;
+    int64 m_ctg, m_scf, l;
+    uint64 slen;
+    char t, *s;
+
+    of = oneFileOpenRead(fn, NULL, "gdb", 1);
+    if (of == NULL) return NULL;
+    MYCALLOC(g, 1);
+    if (g == NULL)
+        mem_alloc_error("gdb");
+    m_ctg = m_scf = 0;
+    slen = 0;
+    while ((t = oneReadLine(of))) {
+        if (t == 'S') {
+            if (g->n_scf == m_scf) {
+                m_scf = m_scf? m_scf << 1 : 1024;
+                MYREALLOC(g->names, m_scf);
+                MYREALLOC(g->slen, m_scf);
+                if (g->names == NULL || g->slen == NULL)
+                    mem_alloc_error("gdb");
+            }
+            s = oneString(of);
+            for (l = 0; l < oneLen(of) && s[l] && !isspace((unsigned char) s[l]); l++) {}
+            MYMALLOC(g->names[g->n_scf], l + 1);
+            if (g->names[g->n_scf] == NULL)
+                mem_alloc_error("gdb");
+            memcpy(g->names[g->n_scf], s, l);
+            g->names[g->n_scf][l] = '\0';
+            g->slen[g->n_scf++] = 0;
+            slen = 0;
+        } else if ((t == 'G' || t == 'C') && g->n_scf > 0) {
+            if (t == 'C') {
+                if (g->n_ctg == m_ctg) {
+                    m_ctg = m_ctg? m_ctg << 1 : 1024;
+                    MYREALLOC(g->scf, m_ctg);
+                    MYREALLOC(g->beg, m_ctg);
+                    MYREALLOC(g->len, m_ctg);
+                    if (g->scf == NULL || g->beg == NULL || g->len == NULL)
+                        mem_alloc_error("gdb");
+                }
+                g->scf[g->n_ctg] = g->n_scf - 1;
+                g->beg[g->n_ctg] = slen;
+                g->len[g->n_ctg++] = oneInt(of, 0);
+            }
+            slen += oneInt(of, 0);
+            if (slen > UINT32_MAX) {
+                fprintf(stderr, "[E::%s] scaffold %s in %s is too long\n", __func__, g->names[g->n_scf - 1], fn);
+                exit (1);
+            }
+            g->slen[g->n_scf - 1] = slen;
+        }
+    }
+    oneFileClose(of);
+    return g;
+}
+
+static onegdb_t *onegdb_open(const char *fn, const char *aln)
+{
+    // FastGA records the path of the .1gdb as given to it; try it next to the .1aln as well
+    onegdb_t *g;
+    const char *p;
+    char *path;
+
+    if ((g = onegdb_read(fn)) != NULL || fn[0] == '/' || (p = strrchr(aln, '/')) == NULL)
+        return g;
+    MYMALLOC(path, p - aln + strlen(fn) + 2);
+    if (path == NULL)
+        mem_alloc_error("gdb path");
+    memcpy(path, aln, p - aln + 1);
+    strcpy(path + (p - aln + 1), fn);
+    g = onegdb_read(path);
+    free(path);
+    return g;
+}
+
+onealn_file_t *onealn_open(const char *fn)
+{
+    onealn_file_t *af;
+    int i, n_ref;
+
+    MYCALLOC(af, 1);
+    if (af == NULL)
+        mem_alloc_error("1aln file");
+    af->of = oneFileOpenRead(fn, NULL, "aln", 1);
+    if (af->of == NULL) {
+        free(af);
+        return NULL;
+    }
+    n_ref = af->of->info['<']? af->of->info['<']->accum.count : 0;
+    if (n_ref < 1) {
+        fprintf(stderr, "[E::%s] no .1gdb referenced by %s\n", __func__, fn);
+        onealn_close(af);
+        return NULL;
+    }
+    for (i = 0; i < 2 && i < n_ref; i++) {
+        af->gdb[i] = onegdb_open(af->of->reference[i].filename, fn);
+        if (af->gdb[i] == NULL) {
+            fprintf(stderr, "[E::%s] cannot open %s referenced by %s\n", __func__, af->of->reference[i].filename, fn);
+            onealn_close(af);
+            return NULL;
+        }
+    }
+    // a self comparison references a single .1gdb
+    if (af->gdb[1] == NULL)
+        af->gdb[1] = af->gdb[0];
+    while ((af->t = oneReadLine(af->of)) && af->t != 'A') {}
+    return af;
+}
+
+int onealn_read(onealn_file_t *af, paf_rec_t *r)
+{
+    // an 'A' line is followed by the lines of the same alignment up to the next 'A'
+    // 'R' marks b as reverse complemented, with its coordinates on the reverse strand of the contig
+    // 'D' is the number of differences; the matches are estimated from it as ALNtoPAF does
+    onegdb_t *ga = af->gdb[0], *gb = af->gdb[1];
+    int64 a, ab, ae, b, bb, be, diffs, sum;
+    int rev;
+
+    if (af->t != 'A')
+        return -1;
+    a  = oneInt(af->of, 0);
+    ab = oneInt(af->of, 1);
+    ae = oneInt(af->of, 2);
+    b  = oneInt(af->of, 3);
+    bb = oneInt(af->of, 4);
+    be = oneInt(af->of, 5);
+    rev = 0;
+    diffs = 0;
+    while ((af->t = oneReadLine(af->of)) && af->t != 'A') {
+        if (af->t == 'R') rev = 1;
+        else if (af->t == 'D') diffs = oneInt(af->of, 0);
+    }
+    if (a < 0 || a >= ga->n_ctg || b < 0 || b >= gb->n_ctg) {
+        fprintf(stderr, "[E::%s] contig out of range in alignment %lld\n", __func__, af->n);
+        exit (1);
+    }
+
+    r->qn = ga->names[ga->scf[a]];
+    r->qnl = strlen(r->qn);
+    r->ql = ga->slen[ga->scf[a]];
+    r->qs = ga->beg[a] + ab;
+    r->qe = ga->beg[a] + ae;
+    r->tn = gb->names[gb->scf[b]];
+    r->tnl = strlen(r->tn);
+    r->tl = gb->slen[gb->scf[b]];
+    if (rev) {
+        r->ts = gb->beg[b] + (gb->len[b] - be);
+        r->te = gb->beg[b] + (gb->len[b] - bb);
+    } else {
+        r->ts = gb->beg[b] + bb;
+        r->te = gb->beg[b] + be;
+    }
+    r->rev = rev;
+    sum = (ae - ab) + (be - bb);
+    r->ml = sum > diffs? (sum - diffs) / 2 : 0;
+    r->bl = sum / 2;
+    r->mq = 255;
+    r->aux = NULL;
+    af->n++;
+    return 0;
+}
+
+void onealn_close(onealn_file_t *af)
+{
+    if (af == NULL) return;
+    if (af->gdb[1] != af->gdb[0])
+        onegdb_destroy(af->gdb[1]);
+    onegdb_destroy(af->gdb[0]);
+    if (af->of)
+        oneFileClose(af->of);
+    free(af);
+}
+
+#else
+
+struct onealn_file_s {
+    int dummy;
+};
+
+onealn_file_t *onealn_open(const char *fn)
+{
+    fprintf(stderr, "[E::%s] built without ONElib; convert %s with ALNtoPAF or rebuild with 'make ONE=<dir>'\n", __func__, fn);
+    return NULL;
+}
+
+int onealn_read(onealn_file_t *af, paf_rec_t *r)
+{
+    return -1;
+}
+
+void onealn_close(onealn_file_t *af)
+{
+    free(af);
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#ifndef ONEALN_H_
+#define ONEALN_H_
+
+#include "paf.h"
+
+// FastGA .1aln alignments are read with ONElib, available when built with "make ONE=<dir>"
+// records are returned in PAF coordinates: sequences are the scaffolds of the referenced .1gdb
+
+typedef struct onealn_file_s onealn_file_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int onealn_is(const char *fn);
+onealn_file_t *onealn_open(const char *fn);
+int onealn_read(onealn_file_t *af, paf_rec_t *r);
+void onealn_close(onealn_file_t *af);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ONEALN_H_ */
@@ -1,17 +1,54 @@
 #include <zlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "kseq.h"
 #include "paf.h"
 
 KSTREAM_INIT(gzFile, gzread, 0x10000)
 
+static const char *paf_map(const char *fn, size_t *l)
+{ // map a non-empty regular file that is not gzip compressed
+  // the last line must be terminated so that numbers are never decoded past the mapping
+	int fd;
+	struct stat st;
+	unsigned char magic[2], last;
+	void *map = 0;
+	if (fn == 0 || strcmp(fn, "-") == 0) return 0;
+	if ((fd = open(fn, O_RDONLY)) < 0) return 0;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 1
+			&& !(pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+			&& pread(fd, &last, 1, st.st_size - 1) == 1 && last == '\n') {
+		map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) map = 0;
+		else madvise(map, st.st_size, MADV_SEQUENTIAL), *l = st.st_size;
+	}
+	close(fd);
+	return (const char*)map;
+}
+
 paf_file_t *paf_open(const char *fn)
 {
 	kstream_t *ks;
 	gzFile fp;
 	paf_file_t *pf;
+	const char *map;
+	size_t map_l = 0;
+	if ((map = paf_map(fn, &map_l)) != 0) {
+		pf = (paf_file_t*)calloc(1, sizeof(paf_file_t));
+		pf->map = map, pf->map_l = map_l;
+		return pf;
+	}
 	fp = fn && strcmp(fn, "-")? gzopen(fn, "r") : gzdopen(fileno(stdin), "r");
 	if (fp == 0) return 0;
 	ks = ks_init(fp);
@@ -25,41 +62,126 @@ int paf_close(paf_file_t *pf)
 	kstream_t *ks;
 	if (pf == 0) return 0;
 	free(pf->buf.s);
-	ks = (kstream_t*)pf->fp;
-	gzclose(ks->f);
-	ks_destroy(ks);
+	if (pf->map) {
+		munmap((void*)pf->map, pf->map_l);
+	} else {
+		ks = (kstream_t*)pf->fp;
+		gzclose(ks->f);
+		ks_destroy(ks);
+	}
 	free(pf);
 	return 0;
 }
 
-int paf_parse(int l, char *s, paf_rec_t *pr) // s must be NULL terminated
-{ // on return: <0 for failure; 0 for success; >0 for filtered
-  	char *q, *r;
-	int i, t;
-	pr->mq  = 255;
-	pr->aux = 0;
-	for (i = t = 0, q = s; i <= l; ++i) {
-		if (i < l && s[i] != '\t') continue;
-		s[i] = 0;
-		if (t == 0) pr->qn = q;
-		else if (t == 1) pr->ql = strtol(q, &r, 10);
-		else if (t == 2) pr->qs = strtol(q, &r, 10);
-		else if (t == 3) pr->qe = strtol(q, &r, 10);
-		else if (t == 4) pr->rev = (*q == '-');
-		else if (t == 5) pr->tn = q;
-		else if (t == 6) pr->tl = strtol(q, &r, 10);
-		else if (t == 7) pr->ts = strtol(q, &r, 10);
-		else if (t == 8) pr->te = strtol(q, &r, 10);
-		else if (t == 9) pr->ml = strtol(q, &r, 10);
-		else if (t == 10) pr->bl = strtol(q, &r, 10);
-		else if (t == 11) pr->mq = strtol(q, &r, 10);
-		++t, q = i < l? &s[i+1] : 0;
-		if (t == 12) pr->aux = q;
+int paf_next_line(paf_file_t *pf, const char **line)
+{ // length of the next line or -1 on EOF; mapped lines point into the mapping and are NOT NULL terminated
+	int ret, dret;
+	const char *s, *e;
+	if (pf->map) {
+		if (pf->map_i >= pf->map_l) return -1;
+		s = pf->map + pf->map_i;
+		e = (const char*)memchr(s, '\n', pf->map_l - pf->map_i);
+		if (e == 0) e = pf->map + pf->map_l;
+		pf->map_i = e - pf->map + 1;
+		if (e - s > 1 && e[-1] == '\r') --e;
+		*line = s;
+		return e - s;
 	}
-	if (t < 12) return -1;
+	ret = ks_getuntil((kstream_t*)pf->fp, KS_SEP_LINE, &pf->buf, &dret);
+	if (ret < 0) return ret;
+	*line = pf->buf.s;
+	return pf->buf.l;
+}
+
+void paf_release(const char *beg, const char *end)
+{ // drop the pages of a consumed part of a mapping from memory; they are read again if touched
+	long pg = sysconf(_SC_PAGESIZE);
+	uintptr_t b = ((uintptr_t)beg + pg - 1) / pg * pg, e = (uintptr_t)end / pg * pg;
+	if (b < e) madvise((void*)b, e - b, MADV_DONTNEED);
+}
+
+static int paf_copy_line(paf_file_t *pf)
+{ // the next line in pf->buf
+	const char *s;
+	int l;
+	if ((l = paf_next_line(pf, &s)) < 0) return l;
+	if (pf->map) {
+		pf->buf.l = 0;
+		if (pf->buf.m < (size_t)l + 1) {
+			pf->buf.m = l + 1;
+			pf->buf.s = (char*)realloc(pf->buf.s, pf->buf.m);
+		}
+		memcpy(pf->buf.s, s, l);
+		pf->buf.s[pf->buf.l = l] = 0;
+	}
+	return l;
+}
+
+int paf_tabs(const char *s, int l, int *tabs, int max)
+{ // positions of the first max tabs in s[0..l); 16/32 bytes at a time with SSE2/AVX2
+	int i = 0, n = 0;
+#if defined(__SSE2__) || defined(__AVX2__)
+	uint32_t m;
+#endif
+#if defined(__AVX2__)
+	const __m256i t32 = _mm256_set1_epi8('\t');
+	for (; i + 32 <= l && n < max; i += 32) {
+		m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s + i)), t32));
+		for (; m && n < max; m &= m - 1)
+			tabs[n++] = i + __builtin_ctz(m);
+	}
+#endif
+#if defined(__SSE2__) || defined(__AVX2__)
+	const __m128i t16 = _mm_set1_epi8('\t');
+	for (; i + 16 <= l && n < max; i += 16) {
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + i)), t16));
+		for (; m && n < max; m &= m - 1)
+			tabs[n++] = i + __builtin_ctz(m);
+	}
+#endif
+	for (; i < l && n < max; ++i)
+		if (s[i] == '\t') tabs[n++] = i;
+	return n;
+}
+
+static int paf_fill(const char *s, const int *tabs, int n, paf_rec_t *pr)
+{
+	if (n < 11) return -1;
+	pr->qn  = s;
+	pr->qnl = tabs[0];
+	pr->ql  = paf_atou(s + tabs[0] + 1);
+	pr->qs  = paf_atou(s + tabs[1] + 1);
+	pr->qe  = paf_atou(s + tabs[2] + 1);
+	pr->rev = (s[tabs[3] + 1] == '-');
+	pr->tn  = s + tabs[4] + 1;
+	pr->tnl = tabs[5] - tabs[4] - 1;
+	pr->tl  = paf_atou(s + tabs[5] + 1);
+	pr->ts  = paf_atou(s + tabs[6] + 1);
+	pr->te  = paf_atou(s + tabs[7] + 1);
+	pr->ml  = paf_atou(s + tabs[8] + 1);
+	pr->bl  = paf_atou(s + tabs[9] + 1);
+	pr->mq  = paf_atou(s + tabs[10] + 1);
+	pr->aux = n == 12? s + tabs[11] + 1 : 0;
 	return 0;
 }
 
+int paf_split(int l, const char *s, paf_rec_t *pr)
+{ // on return: <0 for failure; 0 for success
+  // only the 12 mandatory columns are split; s is not modified
+	int tabs[12];
+	return paf_fill(s, tabs, paf_tabs(s, l, tabs, 12), pr);
+}
+
+int paf_parse(int l, char *s, paf_rec_t *pr) // s must be NULL terminated
+{ // on return: <0 for failure; 0 for success; >0 for filtered
+  // as paf_split() with the mandatory columns NULL terminated
+	int i, n, tabs[12];
+	n = paf_tabs(s, l, tabs, 12);
+	if (n < 11) return -1;
+	for (i = 0; i < n; ++i) s[tabs[i]] = 0;
+	return paf_fill(s, tabs, n, pr);
+}
+
 int paf_recover_aux(paf_file_t *pf, paf_rec_t *pr)
 {
 	char *p, *q;
@@ -78,9 +200,9 @@ int paf_recover_aux(paf_file_t *pf, paf_rec_t *pr)
 
 int paf_read(paf_file_t *pf, paf_rec_t *r)
 {
-	int ret, dret;
+	int ret;
 file_read_more:
-	ret = ks_getuntil((kstream_t*)pf->fp, KS_SEP_LINE, &pf->buf, &dret);
+	ret = paf_copy_line(pf);
 	if (ret < 0) return ret;
 	ret = paf_parse(pf->buf.l, pf->buf.s, r);
 	if (ret < 0) goto file_read_more;
@@ -89,8 +211,6 @@ file_read_more:
 
 char *paf_read_line(paf_file_t *pf)
 {
-	int ret, dret;
-	ret = ks_getuntil((kstream_t*)pf->fp, KS_SEP_LINE, &pf->buf, &dret);
-	if (ret < 0) return NULL;
+	if (paf_copy_line(pf) < 0) return NULL;
 	return pf->buf.s;
 }
@@ -17,22 +17,39 @@ typedef struct __kstring_t {
 typedef struct {
 	void *fp;
 	kstring_t buf;
+	const char *map; // mmap'ed uncompressed input; NULL when reading through zlib
+	size_t map_l, map_i;
 } paf_file_t;
 
 typedef struct {
 	const char *qn, *tn, *aux; // these point to the input string; NOT allocated
 	uint32 ql, qs, qe, tl, ts, te;
 	uint32 ml:31, rev:1, bl, mq;
+	uint32 qnl, tnl; // name lengths; names from paf_split() are not NULL terminated
 } paf_rec_t;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+static inline int64_t paf_atou(const char *s)
+{ // unsigned decimal up to the first non-digit
+	int64_t x = 0;
+	uint32_t d;
+	while ((d = (uint8_t)*s - '0') < 10)
+		x = x * 10 + d, ++s;
+	return x;
+}
+
 paf_file_t *paf_open(const char *fn);
 int paf_close(paf_file_t *pf);
+int paf_tabs(const char *s, int l, int *tabs, int max);
+int paf_split(int l, const char *s, paf_rec_t *pr);
+int paf_parse(int l, char *s, paf_rec_t *pr);
 int paf_read(paf_file_t *pf, paf_rec_t *r);
 char *paf_read_line(paf_file_t *pf);
+int paf_next_line(paf_file_t *pf, const char **line);
+void paf_release(const char *beg, const char *end);
 int paf_recover_aux(paf_file_t *pf, paf_rec_t *pr);
 
 #ifdef __cplusplus
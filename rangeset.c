@@ -0,0 +1,294 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rangeset.h"
+
+#define rs_sum(rs, t) ((t)? (rs)->a[t].sum : 0)
+
+static inline void rs_pull(rangeset_t *rs, uint32 t)
+{
+    rs_node_t *x = &rs->a[t];
+    x->sum = x->end - x->beg + rs_sum(rs, x->l) + rs_sum(rs, x->r);
+}
+
+static uint32 rs_new(rangeset_t *rs, int64 beg, int64 end)
+{
+    uint32 t;
+    if (rs->free) {
+        t = rs->free;
+        rs->free = rs->a[t].l;
+    } else {
+        if (rs->n == 0) rs->n = 1;
+        if (rs->n >= rs->m) {
+            rs->m = rs->m? rs->m << 1 : 16;
+            MYREALLOC(rs->a, rs->m);
+            if (rs->a == NULL)
+                mem_alloc_error("rangeset");
+        }
+        t = rs->n++;
+    }
+    // xorshift32 priorities
+    if (rs->seed == 0) rs->seed = 0x9e3779b9;
+    rs->seed ^= rs->seed << 13, rs->seed ^= rs->seed >> 17, rs->seed ^= rs->seed << 5;
+    rs->a[t] = (rs_node_t) {beg, end, end - beg, rs->seed, 0, 0};
+    return t;
+}
+
+static void rs_free(rangeset_t *rs, uint32 t)
+{
+    // returns the nodes of a subtree to the free list
+    if (t == 0) return;
+    rs_free(rs, rs->a[t].r);
+    rs_free(rs, rs->a[t].l);
+    rs->a[t].l = rs->free;
+    rs->free = t;
+    --rs->n_range;
+}
+
+static void rs_split(rangeset_t *rs, uint32 t, int64 key, uint32 *l, uint32 *r)
+{
+    // l: ranges starting before key; r: the others
+    if (t == 0) {
+        *l = *r = 0;
+    } else if (rs->a[t].beg < key) {
+        rs_split(rs, rs->a[t].r, key, &rs->a[t].r, r);
+        rs_pull(rs, t);
+        *l = t;
+    } else {
+        rs_split(rs, rs->a[t].l, key, l, &rs->a[t].l);
+        rs_pull(rs, t);
+        *r = t;
+    }
+}
+
+static uint32 rs_merge(rangeset_t *rs, uint32 l, uint32 r)
+{
+    // all ranges in l start before those in r
+    if (l == 0 || r == 0) return l? l : r;
+    if (rs->a[l].pri > rs->a[r].pri) {
+        rs->a[l].r = rs_merge(rs, rs->a[l].r, r);
+        rs_pull(rs, l);
+        return l;
+    } else {
+        rs->a[r].l = rs_merge(rs, l, rs->a[r].l);
+        rs_pull(rs, r);
+        return r;
+    }
+}
+
+static inline uint32 rs_last(const rangeset_t *rs, uint32 t)
+{
+    if (t) while (rs->a[t].r) t = rs->a[t].r;
+    return t;
+}
+
+void rangeset_destroy(rangeset_t *rs)
+{
+    free(rs->a);
+    memset(rs, 0, sizeof(rangeset_t));
+}
+
+static int64 rs_prefix(const rangeset_t *rs, int64 x)
+{
+    // covered length before x
+    const rs_node_t *p;
+    uint32 t = rs->root;
+    int64 s = 0;
+    while (t) {
+        p = &rs->a[t];
+        if (x <= p->beg) {
+            t = p->l;
+        } else {
+            s += rs_sum(rs, p->l) + (x < p->end? x : p->end) - p->beg;
+            if (x <= p->end) break; // the ranges on the right start after x
+            t = p->r;
+        }
+    }
+    return s;
+}
+
+int64 rangeset_cover(const rangeset_t *rs, int64 beg, int64 end)
+{
+    // covered length in [beg, end)
+    if (beg >= end || rs->root == 0) return 0;
+    return rs_prefix(rs, end) - rs_prefix(rs, beg);
+}
+
+void rangeset_add(rangeset_t *rs, int64 beg, int64 end)
+{
+    uint32 l, m, r, t;
+    if (beg >= end) return;
+    rs_split(rs, rs->root, beg, &l, &r);
+    // the last range starting before beg may reach it
+    t = rs_last(rs, l);
+    if (t && rs->a[t].end >= beg) {
+        beg = rs->a[t].beg;
+        if (end < rs->a[t].end) end = rs->a[t].end;
+        rs_split(rs, l, beg, &l, &m);
+        rs_free(rs, m);
+    }
+    // ranges starting in [beg, end] are absorbed
+    rs_split(rs, r, end + 1, &m, &r);
+    t = rs_last(rs, m);
+    if (t && end < rs->a[t].end) end = rs->a[t].end;
+    rs_free(rs, m);
+    t = rs_new(rs, beg, end);
+    ++rs->n_range;
+    rs->root = rs_merge(rs, rs_merge(rs, l, t), r);
+}
+
+int rangeset_find(const rangeset_t *rs, int64 pos, int64 *beg, int64 *end)
+{
+    // the range containing pos, if any
+    uint32 t = rs->root, c = 0;
+    while (t) {
+        if (rs->a[t].beg <= pos) c = t, t = rs->a[t].r;
+        else t = rs->a[t].l;
+    }
+    if (c == 0 || rs->a[c].end <= pos) return 0;
+    *beg = rs->a[c].beg;
+    *end = rs->a[c].end;
+    return 1;
+}
+
+void rangeset_stats(const rangeset_t *rs, int64 *n_range, int64 *n_base)
+{
+    *n_range = rs->n_range;
+    *n_base  = rs_sum(rs, rs->root);
+}
+
+#ifdef RANGESET_MAIN
+// compares the treap with a sorted array updated in place, as used before
+typedef struct {
+    int64 beg, end;
+} range_t;
+
+typedef struct {
+    int64 n, m;
+    range_t *a;
+} rarray_t;
+
+static int64 find_last_small(range_t *ranges, int64 n, int64 val)
+{
+    int64 low = 0, high = n - 1, mid, res = -1;
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        if (ranges[mid].end < val) res = mid, low = mid + 1;
+        else high = mid - 1;
+    }
+    return res;
+}
+
+static int64 find_first_large(range_t *ranges, int64 n, int64 val)
+{
+    int64 low = 0, high = n - 1, mid, res = n;
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        if (ranges[mid].beg > val) res = mid, high = mid - 1;
+        else low = mid + 1;
+    }
+    return res;
+}
+
+static int64 rarray_cover(rarray_t *s, int64 beg, int64 end, int64 *_b, int64 *_e)
+{
+    int64 b, e, o, x, y;
+    *_b = -1, *_e = s->n;
+    if (beg >= end || s->n == 0) return 0;
+    *_b = b = find_last_small(s->a, s->n, beg);
+    *_e = e = find_first_large(s->a, s->n, end);
+    for (o = 0; ++b < e; ) {
+        x = s->a[b].beg > beg? s->a[b].beg : beg;
+        y = s->a[b].end < end? s->a[b].end : end;
+        if (x < y) o += y - x;
+    }
+    return o;
+}
+
+static void rarray_add(rarray_t *s, int64 beg, int64 end, int64 b, int64 e)
+{
+    int64 n = s->n + b - e + 2;
+    if (beg >= end) return;
+    if (s->m < n) {
+        s->m = n << 1;
+        MYREALLOC(s->a, s->m);
+    }
+    if (b + 1 < e && s->a[b+1].beg < beg) beg = s->a[b+1].beg;
+    if (b + 1 < e && s->a[e-1].end > end) end = s->a[e-1].end;
+    if (s->n > e) memmove(s->a + b + 2, s->a + e, sizeof(range_t) * (s->n - e));
+    s->a[b+1] = (range_t) {beg, end};
+    s->n = n;
+}
+
+int main(int argc, char *argv[])
+{
+    // usage: rangeset_bench [n_max]
+    // n random ranges are queried and added to both sets, which must agree
+    int64 n, n_max, i, b, e, beg, end, o1, o2, cs1, cs2, genome;
+    double t, t1, t2;
+    uint64 x = 11;
+    rangeset_t rs;
+    rarray_t ra;
+
+    n_max = argc > 1? atoll(argv[1]) : 256000;
+    printf("#N\tarray_sec\ttreap_sec\n");
+    for (n = 1000; n <= n_max; n *= 4) {
+        memset(&rs, 0, sizeof(rangeset_t));
+        memset(&ra, 0, sizeof(rarray_t));
+        genome = n * 10000;
+        t1 = t2 = 0, cs1 = cs2 = 0;
+        for (i = 0; i < n; i++) {
+            x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+            beg = x % genome;
+            end = beg + 100 + (x >> 40) % 5000;
+            t = realtime();
+            o1 = rarray_cover(&ra, beg, end, &b, &e);
+            if (o1 <= (end - beg) / 2) rarray_add(&ra, beg, end, b, e);
+            t1 += realtime() - t;
+            t = realtime();
+            o2 = rangeset_cover(&rs, beg, end);
+            if (o2 <= (end - beg) / 2) rangeset_add(&rs, beg, end);
+            t2 += realtime() - t;
+            cs1 += o1, cs2 += o2;
+        }
+        if (cs1 != cs2 || ra.n != rs.n_range) {
+            fprintf(stderr, "[E::%s] results differ at n = %lld\n", __func__, n);
+            return 1;
+        }
+        printf("%lld\t%.3f\t%.3f\n", n, t1, t2);
+        free(ra.a);
+        rangeset_destroy(&rs);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,68 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#ifndef RANGESET_H_
+#define RANGESET_H_
+
+#include "misc.h"
+
+// a set of disjoint ranges [beg, end) kept in a treap ordered by beg; ranges that overlap or touch are merged
+// each node holds the covered length of its subtree, so insertion and coverage queries are O(log n)
+// a zero-initialized rangeset_t is an empty set
+
+typedef struct {
+    int64  beg, end;
+    int64  sum; // covered length of the subtree
+    uint32 pri;
+    uint32 l, r; // children; 0 for none
+} rs_node_t;
+
+typedef struct {
+    uint32 n, m; // nodes used (including the unused node 0) and allocated
+    uint32 root, free; // free nodes are chained through l
+    uint32 seed;
+    int64  n_range;
+    rs_node_t *a;
+} rangeset_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void rangeset_destroy(rangeset_t *rs);
+int64 rangeset_cover(const rangeset_t *rs, int64 beg, int64 end);
+void rangeset_add(rangeset_t *rs, int64 beg, int64 end);
+int rangeset_find(const rangeset_t *rs, int64 pos, int64 *beg, int64 *end);
+void rangeset_stats(const rangeset_t *rs, int64 *n_range, int64 *n_base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RANGESET_H_ */
@@ -162,6 +162,46 @@ sdict_t *make_sdict_from_fa(const char *f, uint32 min_len)
     return d;
 }
 
+uint32 sd_load_fa(sdict_t *d, const char *f, const uint8 *need)
+{
+    // fill in sequences for names already in the dictionary
+    // only those with need[i] != 0 are loaded if need is not NULL
+    int fd;
+    int64 l;
+    uint32 i, n;
+    gzFile fp;
+    kseq_t *ks;
+    void *ko = 0;
+
+    ko = kopen(f, &fd);
+    if (ko == 0) {
+        fprintf(stderr, "[E::%s] cannot open file %s for reading\n", __func__, f);
+        exit(EXIT_FAILURE);
+    }
+    fp = gzdopen(fd, "r");
+    ks = kseq_init(fp);
+
+    n = 0;
+    while ((l = kseq_read(ks)) >= 0) {
+        i = sd_get(d, ks->name.s);
+        if (i == UINT32_MAX || (need && !need[i]) || d->s[i].seq)
+            continue;
+        if (l > UINT32_MAX) {
+            fprintf(stderr, "[E::%s] >4G sequence chunks are not supported: %s [%lld]\n", __func__, ks->name.s, l);
+            exit(EXIT_FAILURE);
+        }
+        d->s[i].seq = strdup(ks->seq.s);
+        d->s[i].len = strlen(ks->seq.s);
+        ++n;
+    }
+
+    kseq_destroy(ks);
+    gzclose(fp);
+    kclose(ko);
+
+    return n;
+}
+
 sdict_t *make_sdict_from_index(const char *f, uint32 min_len)
 {
     iostream_t *fp;
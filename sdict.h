@@ -69,6 +69,7 @@ uint32 sd_put(sdict_t *d, const char *name, uint32 len);
 uint32 sd_put1(sdict_t *d, const char *name, const char *seq, uint32 len);
 uint32 sd_get(sdict_t *d, const char *name);
 sdict_t *make_sdict_from_fa(const char *f, uint32 min_len);
+uint32 sd_load_fa(sdict_t *d, const char *f, const uint8 *need);
 sdict_t *make_sdict_from_index(const char *f, uint32 min_len);
 sdict_t *make_sdict_from_gfa(const char *f, uint32 min_len);
 void sd_stats(sdict_t *d, uint64 *n_stats, uint32 *l_stats);
@@ -0,0 +1,185 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sock.h"
+
+static int sock_unix(const char *path, int do_listen)
+{
+    int fd;
+    struct sockaddr_un sa;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "[E::%s] socket path too long: %s\n", __func__, path);
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (do_listen) {
+        unlink(path);
+        if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) == -1 || listen(fd, 128) == -1) {
+            close(fd);
+            return -1;
+        }
+    } else if (connect(fd, (struct sockaddr *) &sa, sizeof(sa)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int sock_tcp(const char *addr, int do_listen)
+{
+    int fd, one, ret;
+    char host[1024], *port;
+    struct addrinfo hints, *res, *r;
+
+    port = strrchr(addr, ':');
+    if (port == NULL || port - addr >= (int) sizeof(host)) {
+        fprintf(stderr, "[E::%s] invalid socket address: %s\n", __func__, addr);
+        return -1;
+    }
+    memcpy(host, addr, port - addr);
+    host[port - addr] = '\0';
+    ++port;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (do_listen) hints.ai_flags = AI_PASSIVE;
+    ret = getaddrinfo(*host? host : (do_listen? NULL : "localhost"), port, &hints, &res);
+    if (ret) {
+        fprintf(stderr, "[E::%s] cannot resolve socket address %s: %s\n", __func__, addr, gai_strerror(ret));
+        return -1;
+    }
+    fd = -1;
+    for (r = res; r; r = r->ai_next) {
+        fd = socket(r->ai_family, r->ai_socktype, r->ai_protocol);
+        if (fd == -1) continue;
+        if (do_listen) {
+            one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, r->ai_addr, r->ai_addrlen) == 0 && listen(fd, 128) == 0)
+                break;
+        } else if (connect(fd, r->ai_addr, r->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int sock_listen(const char *addr)
+{
+    if (strncmp(addr, "unix:", 5) == 0)
+        return sock_unix(addr + 5, 1);
+    return sock_tcp(addr, 1);
+}
+
+int sock_connect(const char *addr)
+{
+    if (strncmp(addr, "unix:", 5) == 0)
+        return sock_unix(addr + 5, 0);
+    return sock_tcp(addr, 0);
+}
+
+int sock_write_all(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char *) buf;
+    ssize_t x;
+    while (n > 0) {
+        x = write(fd, p, n);
+        if (x < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += x;
+        n -= x;
+    }
+    return 0;
+}
+
+sock_t *sock_open(int fd)
+{
+    sock_t *s;
+    MYCALLOC(s, 1);
+    if (s == NULL) return NULL;
+    s->fd = fd;
+    return s;
+}
+
+void sock_close(sock_t *s)
+{
+    if (!s) return;
+    close(s->fd);
+    free(s);
+}
+
+static int sock_fill(sock_t *s)
+{
+    ssize_t x;
+    s->beg = s->end = 0;
+    do {
+        x = read(s->fd, s->buf, BUFF_SIZE);
+    } while (x < 0 && errno == EINTR);
+    if (x <= 0) return -1;
+    s->end = x;
+    return 0;
+}
+
+int sock_read_line(sock_t *s, char *line, int max)
+{
+    // read a line without the trailing newline; -1 on EOF or error
+    int l = 0;
+    for (;;) {
+        if (s->beg == s->end && sock_fill(s) < 0)
+            return -1;
+        while (s->beg < s->end) {
+            char c = s->buf[s->beg++];
+            if (c == '\n') {
+                line[l] = '\0';
+                return l;
+            }
+            if (l < max - 1) line[l++] = c;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/*********************************************************************************
+ * MIT License                                                                   *
+ *                                                                               *
+ * Copyright (c) 2026 Chenxi Zhou <chnx.zhou@gmail.com>                          *
+ *                                                                               *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy  *
+ * of this software and associated documentation files (the "Software"), to deal *
+ * in the Software without restriction, including without limitation the rights  *
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell     *
+ * copies of the Software, and to permit persons to whom the Software is         *
+ * furnished to do so, subject to the following conditions:                      *
+ *                                                                               *
+ * The above copyright notice and this permission notice shall be included in    *
+ * all copies or substantial portions of the Software.                           *
+ *                                                                               *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR    *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,      *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE   *
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER        *
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, *
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE *
+ * SOFTWARE.                                                                     *
+ *********************************************************************************/
+
+/********************************** Revision History *****************************
+ *                                                                               *
+ * 18/10/26 - Chenxi Zhou: Created                                               *
+ *                                                                               *
+ *********************************************************************************/
+#ifndef SOCK_H_
+#define SOCK_H_
+
+#include <stddef.h>
+
+#include "misc.h"
+
+// addresses are either "unix:PATH" for a Unix domain socket or "[HOST]:PORT" for TCP
+
+typedef struct {
+    int fd;
+    int beg, end;
+    char buf[BUFF_SIZE];
+} sock_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int sock_listen(const char *addr);
+int sock_connect(const char *addr);
+int sock_write_all(int fd, const void *buf, size_t n);
+sock_t *sock_open(int fd);
+void sock_close(sock_t *s);
+int sock_read_line(sock_t *s, char *line, int max);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOCK_H_ */
@@ -0,0 +1,25 @@
+#!/bin/sh
+# --max-covered on a (query, target) group large enough to be split into windows must give
+# the same boxes and the same dropped/trimmed counts as the unsplit path (alngap_nosplit)
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+awk 'BEGIN { OFS = "\t"; x = 12345; L = 30000000
+    for (i = 0; i < 20000; i++) {
+        x = (x * 1103515245 + 12345) % 2147483648; l = 400 + x % 500; qs = i * 1500; ts = qs + int(x / 11) % 50
+        print "q0", L, qs, qs + l, "+", "t0", L, ts, ts + l, l - 10, l, 60
+        if (i % 3 == 0) print "q0", L, qs + l + 20, qs + l + 20 + int(x / 13) % 300, "+", "t1", L, qs, qs + int(x / 13) % 300, 50, 300, 60
+        if (i % 5 == 2) print "q0", L, qs + l, qs + 1500, "+", "t1", L, qs, qs + 1500 - l, 50, 1500 - l, 60
+        if (i % 4 == 1) print "q1", L, qs, qs + 200, "+", "t0", L, ts + l + int(x / 17) % 400, ts + l + int(x / 17) % 400 + 200, 150, 200, 60
+    } }' > "$dir/in.paf"
+./alngap -a -t2 --max-covered 0.5 -o "$dir/split.txt" "$dir/in.paf" 2> "$dir/split.log"
+./alngap_nosplit -a -t2 --max-covered 0.5 -o "$dir/whole.txt" "$dir/in.paf" 2> "$dir/whole.log"
+cmp "$dir/split.txt" "$dir/whole.txt"
+a=$(grep 'as covered' "$dir/split.log")
+b=$(grep 'as covered' "$dir/whole.log")
+if [ -z "$a" ] || [ "$a" != "$b" ]; then
+    echo "split: $a" >&2
+    echo "whole: $b" >&2
+    exit 1
+fi
+echo "split_cover: ok ($a)"